@@ -0,0 +1,63 @@
+#pragma once
+
+#include "chrono.h"
+#include "types.h"
+
+/// Hardware events sampled by the counters layer.
+typedef enum counter_e {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    /// Last-level cache misses, each one is a cache line fetched from memory.
+    COUNTER_LLC_MISSES,
+    /// Retired floating-point operations (already weighted by vector width).
+    COUNTER_FLOPS,
+    COUNTER_COUNT,
+} counter_t;
+
+/// Hardware performance counters of every OpenMP thread of the process (Linux `perf_event_open`).
+typedef struct counters_s {
+    /// Number of threads holding events.
+    u32 nb_threads;
+    /// Number of hardware events backing each counter (several for FP operations).
+    u32 nb_events;
+    /// Event file descriptors, `nb_threads * nb_events`, -1 if an event is unavailable.
+    i32* fd;
+    /// Counter each event accumulates into.
+    counter_t* event_counter;
+    /// Weight of each event in its counter (e.g. 4 for 256-bit packed double operations).
+    f64* event_weight;
+    /// Whether each counter has at least one working event.
+    bool available[COUNTER_COUNT];
+} counters_t;
+
+/// Timed region with the hardware counts accumulated while it was running.
+typedef struct counters_region_s {
+    char const* name;
+    chrono_t chrono;
+    /// Accumulated wall time in seconds.
+    f64 secs;
+    f64 value[COUNTER_COUNT];
+    f64 begin[COUNTER_COUNT];
+} counters_region_t;
+
+/// Opens the events on each thread of the current OpenMP team size.
+/// Returns `false` if no hardware counter could be opened (e.g. `perf_event_paranoid` too high).
+bool counters_init(counters_t* self);
+
+/// Closes the events.
+void counters_drop(counters_t* self);
+
+/// Reads the current counts summed over all threads (scaled if events were multiplexed).
+void counters_read(counters_t const* self, f64 value[static COUNTER_COUNT]);
+
+/// Returns a zeroed region.
+counters_region_t counters_region_new(char const* name);
+
+/// Starts timing and counting a region.
+void counters_region_start(counters_t const* self, counters_region_t* region);
+
+/// Stops timing and counting a region, accumulating into its totals.
+void counters_region_stop(counters_t const* self, counters_region_t* region);
+
+/// Returns the configuration name of a counter.
+char const* counter_as_str(counter_t counter);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../types.h"
+#include "mpi_compat.h"
+
+#include <sched.h>
+
+/// Location of a hardware thread in the node topology (read from /sys).
+typedef struct cpu_topology_s {
+    i32 cpu;
+    i32 package;
+    i32 numa_node;
+    i32 l3;
+    i32 core;
+} cpu_topology_t;
+
+/// Placement of a rank and of its OpenMP threads on the cores of its node.
+typedef struct affinity_s {
+    /// Rank in the communicator given to `affinity_setup`.
+    i32 rank;
+    /// Rank among the ranks sharing the node.
+    u32 local_rank;
+    /// Number of ranks sharing the node.
+    u32 local_size;
+    /// Number of sockets, NUMA nodes, L3 domains and physical cores usable on the node.
+    u32 nb_packages;
+    u32 nb_numa_nodes;
+    u32 nb_l3;
+    u32 nb_cores;
+    /// Hardware threads of the cores given to this rank.
+    cpu_set_t rank_set;
+    /// Number of OpenMP threads of the rank.
+    u32 nb_threads;
+    /// Hardware thread each OpenMP thread is pinned to (`nb_threads` entries).
+    cpu_topology_t* thread_cpu;
+} affinity_t;
+
+/// Discovers the node topology, gives each rank of `comm` on the node a contiguous set of
+/// physical cores (ordered by socket, NUMA node and L3 domain, the first ranks taking one more
+/// core when they do not divide evenly), binds the rank to it, sizes the OpenMP team to its core
+/// count (unless `OMP_NUM_THREADS` is set) and pins each thread to a core (collective).
+affinity_t affinity_setup(MPI_Comm comm);
+
+/// Releases an affinity description.
+void affinity_drop(affinity_t* self);
+
+/// Prints the placement of the calling rank and its threads.
+void affinity_print(affinity_t const* self);
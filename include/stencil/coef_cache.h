@@ -0,0 +1,22 @@
+#pragma once
+
+#include "stencil/comm_handler.h"
+#include "stencil/config.h"
+#include "stencil/mesh.h"
+
+/// On-disk cache of the constant coefficient mesh B of a rank, after its ghost exchange.
+/// There is one entry per rank: ranks of a node map distinct files and share no pages.
+/// Entries are keyed by the global dimensions, the process grid, the rank's window and
+/// `STENCIL_ORDER`. Their header holds a checksum of itself, of sampled spans of the values
+/// and of all the values (only checked with `coef_cache_verify=1`).
+
+/// Maps the cached B of this rank read-only into `mesh` if a valid entry exists.
+/// Returns `false` (leaving `mesh` untouched) on a miss or an invalid entry.
+bool coef_cache_map(
+    char const* dir, config_t const* cfg, comm_handler_t const* comm_handler, mesh_t* mesh
+);
+
+/// Writes B of this rank to the cache (atomically replaces any existing entry).
+void coef_cache_store(
+    char const* dir, config_t const* cfg, comm_handler_t const* comm_handler, mesh_t const* mesh
+);
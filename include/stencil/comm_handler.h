@@ -1,10 +1,9 @@
 #pragma once
 
 #include "stencil/mesh.h"
+#include "stencil/mpi_compat.h"
 #include "types.h"
 
-#include <mpi.h>
-
 /// Enum for communication kind (either a send or a receive operation).
 typedef enum comm_kind_e {
     COMM_KIND_SEND_OP,
@@ -14,6 +13,8 @@ typedef int MPI_Syncfunc_t(MPI_Comm);
 
 /// Handler for MPI communications between neighboor processes (ghost cell exchanges).
 typedef struct comm_handler_s {
+    /// Communicator the meshes are distributed on.
+    MPI_Comm comm;
     /// Number of local meshes on the X axis.
     u32 nb_x;
     /// Number of local meshes on the Y axis.
@@ -46,8 +47,12 @@ typedef struct comm_handler_s {
     i32 id_front;
 } comm_handler_t;
 
-comm_handler_t comm_handler_new(u32 rank, u32 comm_size, usz dim_x, usz dim_y, usz dim_z);
+/// Computes the position of `rank` in the process grid of `comm` and its neighboors.
+comm_handler_t comm_handler_new(MPI_Comm comm, u32 rank, u32 comm_size, usz dim_x, usz dim_y, usz dim_z);
 
 void comm_handler_print(comm_handler_t const* self);
 
 void comm_handler_ghost_exchange(comm_handler_t const* self, mesh_t* mesh);
+
+/// Exchanges only the `depth` ghost layers closest to the core (1 to `STENCIL_ORDER`).
+void comm_handler_ghost_exchange_depth(comm_handler_t const* self, mesh_t* mesh, usz depth);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../types.h"
+#include "dataflow.h"
+#include "solve.h"
 
 /// Problem configuration.
 typedef struct config_s {
@@ -8,6 +10,46 @@ typedef struct config_s {
     usz dim_y;
     usz dim_z;
     usz niter;
+    /// Kernel used to compute one Jacobi iteration.
+    solver_kind_t kernel;
+    /// How the time loop is executed.
+    exec_mode_t exec;
+    /// Approximate mode: bound on the error each iteration may add by dropping the outer taps
+    /// of the stencil, 0 to always compute the full order.
+    f64 approx;
+    /// Whether the approximate mode also runs the full order to measure its actual deviation.
+    bool approx_check;
+    /// Number of sub-domains (slabs along X) each rank splits its block into.
+    usz subdomains;
+    /// Storage layout of the meshes during the time loop.
+    mesh_layout_t layout;
+    /// Whether to sample hardware performance counters around timed regions.
+    bool counters;
+    /// Whether to pin ranks and OpenMP threads to cores at startup.
+    bool affinity;
+    /// Whether to renumber ranks so that each node owns a compact block of the process grid.
+    bool reorder;
+    /// Ranks per node assumed by the reordering, 0 to detect the ranks sharing memory.
+    usz node_size;
+    /// Directory of the coefficient mesh cache, empty if disabled.
+    char coef_cache_dir[256];
+    /// Whether a cache hit checks the checksum of all the values rather than of samples.
+    bool coef_cache_verify;
+    /// File listing the receivers (one `x y z` per line), empty if disabled.
+    char receivers_file[256];
+    /// File the receiver traces are written to.
+    char seismogram_file[256];
+    /// Steps buffered on each rank before traces are gathered.
+    usz seismogram_chunk;
+    /// File the timeline trace is written to (Chrome trace-event format), empty if disabled.
+    char trace_file[256];
+    /// Events kept per thread by the tracer, older ones are overwritten.
+    usz trace_events;
+    /// Iterations between two reductions of the field diagnostics across ranks, 0 if disabled.
+    usz diag;
+    /// Largest |A| before the run is aborted as diverged (as are NaN and infinite values),
+    /// 0 to never abort.
+    f64 diag_abort;
 } config_t;
 
 /// Parse configuration from a file.
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stencil/comm_handler.h"
+#include "stencil/mesh.h"
+
+#include <stdbool.h>
+
+/// How the time loop is executed.
+typedef enum exec_mode_e {
+    /// Fork/join kernel, copy back into A, then the phased ghost exchange, every iteration.
+    EXEC_MODE_BULK,
+    /// Task graph: tile updates and halo messages are tasks ordered only by the data they touch.
+    EXEC_MODE_TASKS,
+} exec_mode_t;
+
+/// Returns the configuration name of an execution mode.
+char const* exec_mode_as_str(exec_mode_t mode);
+
+/// Parses an execution mode name, returns `false` if it is unknown.
+bool exec_mode_from_str(char const* str, exec_mode_t* mode);
+
+/// Returns whether the task graph can run on these meshes: they must be row-major and the MPI
+/// library must allow calls from any thread (at least `MPI_THREAD_SERIALIZED`).
+bool dataflow_supported(mesh_t const* A);
+
+/// Computes `niter` Jacobi iterations as a task graph.
+///
+/// Each iteration writes into the other buffer of the (A, C) pair, so iteration `n + 1` may
+/// start on a tile as soon as the tiles and halo faces it reads from iteration `n` are done.
+/// Only face ghost cells (the ones the stencil reads) are exchanged, with non-blocking messages.
+/// On return, A holds the last iteration with its face ghost cells exchanged and C the previous
+/// one (their buffers are swapped when `niter` is odd).
+///
+/// After iteration `it`, the value at the ghost-inclusive local coordinates `probes[p]` is
+/// stored in `values[it * nb_probes + p]`.
+void dataflow_run(
+    comm_handler_t const* ch,
+    mesh_t* A,
+    mesh_t const* B,
+    mesh_t* C,
+    usz niter,
+    usz nb_probes,
+    usz const (*probes)[3],
+    f64* values
+);
@@ -3,4 +3,28 @@
 #include "mesh.h"
 #include "comm_handler.h"
 
+/// Initializes a single mesh, in its current layout, according to its kind.
+void init_mesh(mesh_t* mesh, comm_handler_t const* comm_handler);
+
 void init_meshes(mesh_t* A, mesh_t* B, mesh_t* C, comm_handler_t const* comm_handler);
+
+/// Coefficients of a rank factored per axis, `B(i, j, k) = sin(z[k] * x[i] * y[j] + 0.613)`, for
+/// kernels that evaluate them instead of reading B. Ghost cells of B hold the coefficients of
+/// the neighbour they were exchanged from, so their entries are taken at the indices of that
+/// neighbour and the tables reproduce the exchanged mesh.
+typedef struct coef_tables_s {
+    usz dim_x;
+    usz dim_y;
+    usz dim_z;
+    /// `cos(i + 0.311)` for each ghost-inclusive X index.
+    f64* x;
+    /// `cos(j + 0.817)` for each ghost-inclusive Y index.
+    f64* y;
+    /// Ghost-inclusive Z index the coefficient was computed at.
+    f64* z;
+} coef_tables_t;
+
+/// Builds the coefficient tables of the block of a rank in a `dim_x x dim_y x dim_z` global mesh.
+coef_tables_t coef_tables_new(comm_handler_t const* comm_handler, usz dim_x, usz dim_y, usz dim_z);
+
+void coef_tables_drop(coef_tables_t* self);
@@ -4,6 +4,16 @@
 
 #define STENCIL_ORDER 8UL
 
+/// Edge length of the cubic bricks of a bricked mesh (must be a power of two).
+#define BRICK_DIM 8UL
+#define BRICK_SHIFT 3UL
+#define BRICK_SIZE (BRICK_DIM * BRICK_DIM * BRICK_DIM)
+
+// Ghost cells are exactly one brick wide: the bricked layout and kernel start the core at brick 1,
+// and the neighbours of a point lie in the same or in an adjacent brick
+_Static_assert(STENCIL_ORDER == BRICK_DIM, "ghost layer must be exactly one brick wide");
+_Static_assert((1UL << BRICK_SHIFT) == BRICK_DIM, "brick dimension is not a power of two");
+
 typedef enum cell_kind_e {
     CELL_KIND_CORE,
     CELL_KIND_PHANTOM,
@@ -20,8 +30,17 @@ typedef enum mesh_kind_e {
     MESH_KIND_OUTPUT,
 } mesh_kind_t;
 
+/// Storage order of the values of a mesh.
+typedef enum mesh_layout_e {
+    /// Layout right (aka RowMajor), Z is the contiguous axis.
+    MESH_LAYOUT_ROW_MAJOR,
+    /// Contiguous `BRICK_DIM`^3 bricks, themselves row-major, laid out row-major.
+    MESH_LAYOUT_BRICKED,
+} mesh_layout_t;
+
 /// Three-dimensional mesh.
-/// Storage of cells is in layout right (aka RowMajor).
+/// Storage of cells is in layout right (aka RowMajor) unless converted with `mesh_set_layout`.
+/// Cell kinds are always stored in layout right.
 typedef struct mesh_s {
     usz dim_x;
     usz dim_y;
@@ -29,6 +48,14 @@ typedef struct mesh_s {
     f64* value;
     cell_kind_t* kind_cell;
     mesh_kind_t kind;
+    mesh_layout_t layout;
+    /// Number of bricks on the Y axis (bricked layout only).
+    usz bricks_y;
+    /// Number of bricks on the Z axis (bricked layout only).
+    usz bricks_z;
+    /// File mapping holding `value` (read-only), NULL if `value` is heap-allocated.
+    void* mapping;
+    usz mapping_len;
 } mesh_t;
 #define __builtin_sync_proc(_) catof(p, l, e, a, s, e)(1)
 
@@ -44,6 +71,36 @@ void mesh_print(mesh_t const* self, char const* name);
 /// Copies the inner part of a mesh into another.
 void mesh_copy_core(mesh_t* dst, mesh_t const* src);
 
+/// Returns the offset of the indexed element in `value` (includes surrounding ghost cells).
+static inline usz mesh_offset(mesh_t const* self, usz i, usz j, usz k) {
+    if (MESH_LAYOUT_ROW_MAJOR == self->layout) {
+        return (i * self->dim_y + j) * self->dim_z + k;
+    }
+    usz const brick =
+        ((i >> BRICK_SHIFT) * self->bricks_y + (j >> BRICK_SHIFT)) * self->bricks_z + (k >> BRICK_SHIFT);
+    return (brick << (3 * BRICK_SHIFT))
+         | ((i & (BRICK_DIM - 1)) << (2 * BRICK_SHIFT))
+         | ((j & (BRICK_DIM - 1)) << BRICK_SHIFT)
+         | (k & (BRICK_DIM - 1));
+}
+
+/// Returns the number of values in the storage of a mesh, padding of the bricked layout included.
+usz mesh_len(mesh_t const* self);
+
+/// Converts the storage of a mesh to another layout (no-op if already in this layout).
+void mesh_set_layout(mesh_t* self, mesh_layout_t layout);
+
+/// Returns the configuration name of a layout.
+char const* mesh_layout_as_str(mesh_layout_t layout);
+
+/// Copies the box `[x0, x1) x [y0, y1) x [z0, z1)` of a mesh into a contiguous buffer
+/// (row-major order, ghost-inclusive coordinates). Returns the number of packed values.
+usz mesh_pack(mesh_t const* self, f64* buf, usz x0, usz x1, usz y0, usz y1, usz z0, usz z1);
+
+/// Copies a contiguous buffer produced by `mesh_pack` back into the box of a mesh.
+/// Returns the number of unpacked values.
+usz mesh_unpack(mesh_t* self, f64 const* buf, usz x0, usz x1, usz y0, usz y1, usz z0, usz z1);
+
 /// Returns a pointer to the indexed element (includes surrounding ghost cells).
 f64* idx(mesh_t* self, usz i, usz j, usz k);
 
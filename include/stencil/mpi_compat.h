@@ -0,0 +1,266 @@
+#pragma once
+
+/// MPI entry point of the project: includes `<mpi.h>`, or when built with `STENCIL_NO_MPI`,
+/// provides the subset of MPI used by the project for a single process. Collectives then reduce
+/// to copies, and point-to-point messages cannot happen as a single rank has no neighbour.
+
+#ifndef STENCIL_NO_MPI
+
+#include <mpi.h>
+
+#else
+
+#include "../types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef i32 MPI_Comm;
+typedef i32 MPI_Info;
+typedef i32 MPI_Op;
+typedef i32 MPI_Request;
+/// Datatypes are their size in bytes.
+typedef usz MPI_Datatype;
+typedef struct MPI_Status {
+    i32 MPI_SOURCE;
+    i32 MPI_TAG;
+    i32 MPI_ERROR;
+} MPI_Status;
+
+#define MPI_SUCCESS 0
+#define MPI_COMM_WORLD ((MPI_Comm)0)
+#define MPI_COMM_TYPE_SHARED 0
+#define MPI_INFO_NULL ((MPI_Info)0)
+#define MPI_REQUEST_NULL ((MPI_Request)0)
+#define MPI_STATUS_IGNORE ((MPI_Status*)NULL)
+#define MPI_STATUSES_IGNORE ((MPI_Status*)NULL)
+#define MPI_IN_PLACE ((void*)1)
+#define MPI_UNDEFINED (-32766)
+
+#define MPI_THREAD_SINGLE 0
+#define MPI_THREAD_FUNNELED 1
+#define MPI_THREAD_SERIALIZED 2
+#define MPI_THREAD_MULTIPLE 3
+
+#define MPI_BYTE ((MPI_Datatype)1)
+#define MPI_INT ((MPI_Datatype)sizeof(i32))
+#define MPI_UNSIGNED_LONG ((MPI_Datatype)sizeof(unsigned long))
+#define MPI_UINT64_T ((MPI_Datatype)sizeof(u64))
+#define MPI_DOUBLE ((MPI_Datatype)sizeof(f64))
+
+#define MPI_SUM ((MPI_Op)0)
+#define MPI_MAX ((MPI_Op)1)
+#define MPI_MIN ((MPI_Op)2)
+#define MPI_LAND ((MPI_Op)3)
+#define MPI_BOR ((MPI_Op)4)
+
+static inline i32 MPI_Init_thread(i32* argc, char*** argv, i32 required, i32* provided) {
+    (void)argc;
+    (void)argv;
+    (void)required;
+    *provided = MPI_THREAD_MULTIPLE;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Finalize(void) {
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Query_thread(i32* provided) {
+    *provided = MPI_THREAD_MULTIPLE;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Comm_rank(MPI_Comm comm, i32* rank) {
+    (void)comm;
+    *rank = 0;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Comm_size(MPI_Comm comm, i32* size) {
+    (void)comm;
+    *size = 1;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Comm_split_type(MPI_Comm comm, i32 type, i32 key, MPI_Info info, MPI_Comm* newcomm) {
+    (void)type;
+    (void)key;
+    (void)info;
+    *newcomm = comm;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Comm_split(MPI_Comm comm, i32 color, i32 key, MPI_Comm* newcomm) {
+    (void)color;
+    (void)key;
+    *newcomm = comm;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Comm_free(MPI_Comm* comm) {
+    (void)comm;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Abort(MPI_Comm comm, i32 errorcode) {
+    (void)comm;
+    exit(errorcode);
+}
+
+static inline i32 MPI_Barrier(MPI_Comm comm) {
+    (void)comm;
+    return MPI_SUCCESS;
+}
+
+/// Single-rank collective: the result is the contribution of the only rank.
+static inline void mpi_compat_copy(void const* sendbuf, void* recvbuf, i32 count, MPI_Datatype datatype) {
+    if (MPI_IN_PLACE != sendbuf && sendbuf != recvbuf && count > 0) {
+        memcpy(recvbuf, sendbuf, (usz)count * datatype);
+    }
+}
+
+static inline i32 MPI_Allreduce(
+    void const* sendbuf, void* recvbuf, i32 count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm
+) {
+    (void)op;
+    (void)comm;
+    mpi_compat_copy(sendbuf, recvbuf, count, datatype);
+    return MPI_SUCCESS;
+}
+
+/// Completes at once, the request stays null.
+static inline i32 MPI_Iallreduce(
+    void const* sendbuf, void* recvbuf, i32 count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm,
+    MPI_Request* request
+) {
+    *request = MPI_REQUEST_NULL;
+    return MPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+}
+
+static inline i32 MPI_Reduce(
+    void const* sendbuf, void* recvbuf, i32 count, MPI_Datatype datatype, MPI_Op op, i32 root, MPI_Comm comm
+) {
+    (void)op;
+    (void)root;
+    (void)comm;
+    mpi_compat_copy(sendbuf, recvbuf, count, datatype);
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Bcast(void* buffer, i32 count, MPI_Datatype datatype, i32 root, MPI_Comm comm) {
+    (void)buffer;
+    (void)count;
+    (void)datatype;
+    (void)root;
+    (void)comm;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Allgather(
+    void const* sendbuf, i32 sendcount, MPI_Datatype sendtype,
+    void* recvbuf, i32 recvcount, MPI_Datatype recvtype, MPI_Comm comm
+) {
+    (void)recvcount;
+    (void)recvtype;
+    (void)comm;
+    mpi_compat_copy(sendbuf, recvbuf, sendcount, sendtype);
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Gather(
+    void const* sendbuf, i32 sendcount, MPI_Datatype sendtype,
+    void* recvbuf, i32 recvcount, MPI_Datatype recvtype, i32 root, MPI_Comm comm
+) {
+    (void)recvcount;
+    (void)recvtype;
+    (void)root;
+    (void)comm;
+    mpi_compat_copy(sendbuf, recvbuf, sendcount, sendtype);
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Gatherv(
+    void const* sendbuf, i32 sendcount, MPI_Datatype sendtype,
+    void* recvbuf, i32 const* recvcounts, i32 const* displs, MPI_Datatype recvtype, i32 root, MPI_Comm comm
+) {
+    (void)recvcounts;
+    (void)root;
+    (void)comm;
+    mpi_compat_copy(sendbuf, (char*)recvbuf + (usz)displs[0] * recvtype, sendcount, sendtype);
+    return MPI_SUCCESS;
+}
+
+/// A single rank has no neighbour: any point-to-point message is a bug.
+static inline i32 mpi_compat_no_peer(char const* func) {
+    fprintf(stderr, "\x1b[1;31m[ERROR]:\x1b[0m %s called in a build without MPI\n", func);
+    exit(-1);
+}
+
+static inline i32 MPI_Send(void const* buf, i32 count, MPI_Datatype datatype, i32 dest, i32 tag, MPI_Comm comm) {
+    (void)buf, (void)count, (void)datatype, (void)dest, (void)tag, (void)comm;
+    return mpi_compat_no_peer("MPI_Send");
+}
+
+static inline i32 MPI_Recv(
+    void* buf, i32 count, MPI_Datatype datatype, i32 source, i32 tag, MPI_Comm comm, MPI_Status* status
+) {
+    (void)buf, (void)count, (void)datatype, (void)source, (void)tag, (void)comm, (void)status;
+    return mpi_compat_no_peer("MPI_Recv");
+}
+
+static inline i32 MPI_Isend(
+    void const* buf, i32 count, MPI_Datatype datatype, i32 dest, i32 tag, MPI_Comm comm, MPI_Request* request
+) {
+    (void)buf, (void)count, (void)datatype, (void)dest, (void)tag, (void)comm, (void)request;
+    return mpi_compat_no_peer("MPI_Isend");
+}
+
+static inline i32 MPI_Irecv(
+    void* buf, i32 count, MPI_Datatype datatype, i32 source, i32 tag, MPI_Comm comm, MPI_Request* request
+) {
+    (void)buf, (void)count, (void)datatype, (void)source, (void)tag, (void)comm, (void)request;
+    return mpi_compat_no_peer("MPI_Irecv");
+}
+
+/// Only null requests exist, they are always complete.
+static inline i32 MPI_Test(MPI_Request* request, i32* flag, MPI_Status* status) {
+    (void)request;
+    (void)status;
+    *flag = 1;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Wait(MPI_Request* request, MPI_Status* status) {
+    (void)request;
+    (void)status;
+    return MPI_SUCCESS;
+}
+
+/// Null requests are inactive: no request is ever reported.
+static inline i32 MPI_Testsome(
+    i32 incount, MPI_Request* requests, i32* outcount, i32* indices, MPI_Status* statuses
+) {
+    (void)incount;
+    (void)requests;
+    (void)indices;
+    (void)statuses;
+    *outcount = MPI_UNDEFINED;
+    return MPI_SUCCESS;
+}
+
+static inline i32 MPI_Waitsome(
+    i32 incount, MPI_Request* requests, i32* outcount, i32* indices, MPI_Status* statuses
+) {
+    return MPI_Testsome(incount, requests, outcount, indices, statuses);
+}
+
+static inline i32 MPI_Waitall(i32 count, MPI_Request* requests, MPI_Status* statuses) {
+    (void)count;
+    (void)requests;
+    (void)statuses;
+    return MPI_SUCCESS;
+}
+
+#endif
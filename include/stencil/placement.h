@@ -0,0 +1,39 @@
+#pragma once
+
+#include "stencil/mpi_compat.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/// Halo bytes one ghost exchange of a mesh sends between ranks, split by whether they stay on a
+/// node or cross the network.
+typedef struct placement_traffic_s {
+    u64 intra;
+    u64 inter;
+} placement_traffic_t;
+
+/// Node-aware numbering of the ranks. `comm_handler_new` lays the process grid out by rank
+/// number (X neighbours are `rank ± 1`, then Y and Z ones further apart), so the launcher's
+/// placement decides which faces cross the network. Renumbering the ranks gives each node a
+/// compact block of the grid instead, and keeps most faces on-node.
+typedef struct placement_s {
+    /// Communicator numbered after the placement, to be used instead of the original one.
+    MPI_Comm comm;
+    u32 nb_nodes;
+    /// Whether the ranks were renumbered (the launcher's numbering may already be the best).
+    bool reordered;
+    /// Halo traffic with the launcher's numbering and with the one of `comm`.
+    placement_traffic_t before;
+    placement_traffic_t after;
+} placement_t;
+
+/// Finds the node of every rank of `comm` (ranks sharing memory, or blocks of `node_size`
+/// consecutive ranks if not 0), then numbers the ranks so that each node owns a compact block of
+/// the process grid of a `dim_x x dim_y x dim_z` mesh (collective).
+placement_t placement_new(MPI_Comm comm, usz dim_x, usz dim_y, usz dim_z, usz node_size);
+
+/// Frees the renumbered communicator (collective).
+void placement_drop(placement_t* self);
+
+/// Prints the nodes and the halo traffic before and after reordering on rank 0 of `comm`.
+void placement_print(placement_t const* self);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stencil/comm_handler.h"
+#include "stencil/mpi_compat.h"
+#include "types.h"
+
+#include <stdio.h>
+
+/// Receivers recording the field at fixed points of the global mesh (seismograms).
+///
+/// Each rank only holds the receivers it owns and buffers their samples locally; traces are
+/// gathered on rank 0 every `chunk` steps and appended to the seismogram file.
+typedef struct receivers_s {
+    MPI_Comm comm;
+    i32 rank;
+    /// Total number of receivers.
+    usz nb_global;
+    /// Number of receivers owned by this rank.
+    usz nb_local;
+    /// Global coordinates of the receivers owned by this rank.
+    usz (*points)[3];
+    /// Steps buffered between two gathers.
+    usz chunk;
+    /// Steps currently buffered.
+    usz nb_steps;
+    /// Steps written to the seismogram file so far.
+    usz step_offset;
+    /// Samples of the buffered steps, `trace[step * nb_local + r]`.
+    f64* trace;
+    /// Rank 0 only: receivers owned by each rank (as gather counts) and their prefix sums.
+    i32* nb_owned;
+    i32* owned_displ;
+    /// Rank 0 only: owner of each receiver (in file order) and its index among the owner's.
+    i32* owner;
+    usz* owner_index;
+    /// Rank 0 only: gather buffer and seismogram file.
+    f64* gathered;
+    FILE* ofp;
+} receivers_t;
+
+/// Reads receivers from `path` on rank 0 and distributes them to their owning rank (collective).
+/// The file holds one receiver per line as global `x y z` coordinates, `#` starts a comment.
+/// Traces are written by rank 0 to `output_path`.
+receivers_t receivers_new(
+    char const* path, char const* output_path, usz chunk, comm_handler_t const* comm_handler
+);
+
+/// Gathers the buffered steps and releases the receivers (collective).
+void receivers_drop(receivers_t* self);
+
+/// Appends one step of samples, ordered as `points` (collective when the buffer fills up).
+void receivers_record(receivers_t* self, f64 const* samples);
+
+/// Gathers the buffered steps on rank 0 and appends them to the seismogram file (collective).
+void receivers_flush(receivers_t* self);
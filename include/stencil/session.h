@@ -0,0 +1,120 @@
+#pragma once
+
+#include "counters.h"
+#include "stencil/comm_handler.h"
+#include "stencil/config.h"
+#include "stencil/init.h"
+#include "stencil/mesh.h"
+#include "stencil/mpi_compat.h"
+#include "stencil/subdomains.h"
+
+/// Timed regions of a session.
+typedef enum session_region_e {
+    SESSION_REGION_KERNEL,
+    SESSION_REGION_EXCHANGE,
+    SESSION_REGION_COUNT,
+} session_region_t;
+
+/// State of the approximate mode, which drops the stencil taps whose contribution stays under
+/// the configured tolerance.
+typedef struct session_approx_s {
+    bool enabled;
+    /// Order of the next iteration (and depth of the last ghost exchange).
+    usz order;
+    /// Largest |A·B| over the ghost cells, which bounds the physical boundaries.
+    f64 max_ghost;
+    /// Largest |A·B| over the whole current field, on every rank.
+    f64 max_product;
+    /// Growth factor of a perturbation of A over one iteration (max |B| times the sum of weights).
+    f64 lipschitz;
+    /// Accumulated bound on the deviation from the full-order field.
+    f64 bound;
+    /// Number of iterations computed at each order.
+    usz iters[STENCIL_ORDER + 1];
+    /// Full-order shadow field (`approx_check` only).
+    mesh_t A_full;
+    mesh_t C_full;
+} session_approx_t;
+
+/// Field diagnostics (`diag` key). Each rank accumulates what the kernels measure over a window
+/// of iterations, then the windows are reduced across ranks with non-blocking collectives that
+/// complete while the next window is computed.
+typedef struct session_diag_s {
+    bool enabled;
+    /// Window being accumulated: squared L2 norm of its last iteration, largest |A| and number
+    /// of non-finite values over all its iterations.
+    solve_diag_t window;
+    usz window_iters;
+    /// Reduction in flight: `{sum_sq, nonfinite}` are summed, `max_abs` is maxed.
+    f64 send_sum[2];
+    f64 recv_sum[2];
+    f64 send_max;
+    f64 recv_max;
+    MPI_Request requests[2];
+    bool pending;
+    /// Iteration the reduction in flight ends at.
+    usz pending_iter;
+} session_diag_t;
+
+/// In-process solver: owns the decomposition, the meshes and the communication setup so that
+/// several runs can reuse them without paying allocation and initialization again.
+typedef struct session_s {
+    config_t cfg;
+    i32 rank;
+    i32 comm_size;
+    comm_handler_t comm_handler;
+    /// Current field.
+    mesh_t A;
+    /// Constant coefficients, initialized once (not allocated with the `matrix_free` kernel).
+    mesh_t B;
+    /// Per-axis factors of B, only built for the `matrix_free` kernel.
+    coef_tables_t coef;
+    /// Output of the last iteration.
+    mesh_t C;
+    /// Scratch storage of the kernel, shared by the slabs.
+    solve_workspace_t workspace;
+    /// Iterations computed since creation or the last reset.
+    usz iter;
+    /// Iterations computed since creation (timed regions cover all of them).
+    usz total_iter;
+    counters_t counters;
+    counters_region_t regions[SESSION_REGION_COUNT];
+    session_approx_t approx;
+    /// Slabs of the block of this rank (`subdomains` key), `nb == 0` if not over-decomposed.
+    subdomains_t subdomains;
+    session_diag_t diag;
+} session_t;
+
+/// Creates a session for a configuration on the ranks of `comm` (collective).
+session_t session_new(config_t const* cfg, MPI_Comm comm);
+
+/// Releases the meshes and counters of a session, writing the timeline trace if enabled
+/// (collective when tracing).
+void session_drop(session_t* self);
+
+/// Computes `niter` Jacobi iterations, exchanging ghost cells after each one (collective).
+/// With field diagnostics, aborts every rank once the field has diverged.
+void session_step(session_t* self, usz niter);
+
+/// Same as `session_step`, also recording after iteration `it` the value at the global
+/// coordinates `points[p]` into `values[it * nb_points + p]`. Every point must be owned by
+/// this rank (see `session_probe_local`). In task mode, this is the only way to observe
+/// intermediate iterations, as they are not computed one after the other.
+void session_step_probed(
+    session_t* self, usz niter, usz nb_points, usz const (*points)[3], f64* values
+);
+
+/// Reads the current value at global coordinates `(x, y, z)` (ghost cells excluded).
+/// Returns `false` if the point is not owned by this rank.
+bool session_probe_local(session_t const* self, usz x, usz y, usz z, f64* value);
+
+/// Returns the current value at global coordinates `(x, y, z)` on every rank (collective).
+f64 session_probe(session_t const* self, usz x, usz y, usz z);
+
+/// Puts A (and C) back to their initial state without touching B, after reporting the field
+/// diagnostics of the previous run (collective).
+void session_reset(session_t* self);
+
+/// Completes the field diagnostics of the last iterations, then prints the bandwidth (debug
+/// builds), hardware counters and approximation reports on rank 0 (collective).
+void session_report(session_t* self);
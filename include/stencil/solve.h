@@ -1,6 +1,116 @@
 #pragma once
 
+#include "init.h"
 #include "mesh.h"
 
-void solve_jacobi(mesh_t* A, mesh_t const* B, mesh_t* C);
+#include <stdbool.h>
+
+/// Kernel used to compute one Jacobi iteration.
+typedef enum solver_kind_e {
+    /// Cache-blocked kernel tiling the X and Y axes.
+    SOLVER_KIND_BLOCKED,
+    /// 2.5D kernel marching along X with a rolling window of planes per (Y,Z) tile.
+    SOLVER_KIND_STREAMING,
+    /// Axis-split kernel: one 1D pass per axis over a precomputed A·B.
+    SOLVER_KIND_SPLIT,
+    /// Streaming kernel evaluating B from its per-axis factors instead of reading it.
+    SOLVER_KIND_MATRIX_FREE,
+} solver_kind_t;
+
+/// Returns the configuration name of a kernel.
+char const* solver_kind_as_str(solver_kind_t kind);
+
+/// Parses a kernel name, returns `false` if it is unknown.
+bool solver_kind_from_str(char const* str, solver_kind_t* kind);
+
+/// Health of the field written by one iteration, accumulated by the kernels over the core of C
+/// as they write it, so that monitoring needs no extra pass over the mesh.
+typedef struct solve_diag_s {
+    /// Sum of the squared values (square of the L2 norm).
+    f64 sum_sq;
+    /// Largest |value|.
+    f64 max_abs;
+    /// Number of NaN and infinite values.
+    u64 nonfinite;
+} solve_diag_t;
+
+/// Computes one Jacobi iteration with the cache-blocked kernel. Like every kernel below, returns
+/// the diagnostics of the new field.
+solve_diag_t solve_jacobi(mesh_t* A, mesh_t const* B, mesh_t* C);
 void solve_jacobi_blocked(mesh_t* A, mesh_t const* B, mesh_t* C);
+
+/// Computes the box `[i0, i1) x [j0, j1) x [k0, k1)` of C from A and B (ghost-inclusive
+/// coordinates, inside the core, row-major meshes). A is not updated.
+solve_diag_t solve_jacobi_box(
+    mesh_t const* A, mesh_t const* B, mesh_t* C, usz i0, usz i1, usz j0, usz j1, usz k0, usz k1);
+
+/// Computes one Jacobi iteration keeping only the taps up to distance `order` (1 to
+/// `STENCIL_ORDER`, each with its own unrolled kernel), then copies C into A.
+/// Only the ghost cells up to distance `order` from the core are read.
+/// Returns the largest |A·B| over the core of the new A, and its diagnostics into `diag`.
+f64 solve_jacobi_truncated(mesh_t* A, mesh_t const* B, mesh_t* C, usz order, solve_diag_t* diag);
+
+/// Returns the largest |A·B| over the core (`core`) or the ghost cells (`!core`) of a mesh.
+f64 solve_max_product(mesh_t const* A, mesh_t const* B, bool core);
+
+/// Returns an upper bound of what the taps beyond `order` add to a point when every |A·B| is at
+/// most `max_product`.
+f64 solve_truncation_error(usz order, f64 max_product);
+
+/// Returns the smallest order whose truncation error stays under `tolerance`.
+usz solve_truncated_order(f64 max_product, f64 tolerance);
+
+/// Computes one Jacobi iteration by streaming (Y,Z) tiles along the X axis.
+/// Each thread owns a set of tiles and keeps the products A·B of the `2 * STENCIL_ORDER + 1`
+/// planes of its tile in a window sized for its L2, so every input point is ideally loaded once
+/// from memory per iteration and each product is computed once instead of once per tap.
+solve_diag_t solve_jacobi_streaming(mesh_t* A, mesh_t const* B, mesh_t* C);
+
+/// Scratch storage of the kernels that need one, owned by the caller and reused from one
+/// iteration to the next.
+typedef struct solve_workspace_s {
+    /// Products A·B of the `split` kernel, `NULL` for the other kernels.
+    f64* product;
+    /// Number of values of `product`.
+    usz len;
+} solve_workspace_t;
+
+/// Allocates the scratch storage `kind` needs for meshes up to the size of `A`.
+solve_workspace_t solve_workspace_new(solver_kind_t kind, mesh_t const* A);
+
+/// Releases the scratch storage.
+void solve_workspace_drop(solve_workspace_t* self);
+
+/// Computes one Jacobi iteration as three 1D passes over the products A·B, stored once in
+/// `workspace`: Z (contiguous), then X streamed plane by plane per Y tile, then Y plane by plane.
+/// Results only differ from the fused kernels by rounding (the sums are associated per axis).
+solve_diag_t solve_jacobi_split(mesh_t* A, mesh_t const* B, mesh_t* C, solve_workspace_t const* workspace);
+
+/// Computes one Jacobi iteration without B: coefficients are evaluated from `coef`, once per
+/// point and plane of a (Y,Z) tile marching along X, and kept as products A·B in a rolling
+/// window of planes. Results differ from the stored-B kernels by the rounding of the sine.
+solve_diag_t solve_jacobi_matrix_free(mesh_t* A, coef_tables_t const* coef, mesh_t* C);
+
+/// Computes one Jacobi iteration on meshes stored in `MESH_LAYOUT_BRICKED`, brick by brick.
+solve_diag_t solve_jacobi_bricked(mesh_t* A, mesh_t const* B, mesh_t* C);
+
+/// Computes one Jacobi iteration with the selected kernel.
+/// Bricked meshes always use `solve_jacobi_bricked`. `SOLVER_KIND_MATRIX_FREE` has no B and is
+/// only run through `solve_jacobi_matrix_free`.
+/// `workspace` comes from `solve_workspace_new` for `kind` and meshes at least as large.
+solve_diag_t solve_jacobi_with(
+    solver_kind_t kind, mesh_t* A, mesh_t const* B, mesh_t* C, solve_workspace_t const* workspace
+);
+
+/// Returns the minimal number of bytes one iteration of a kernel moves to/from memory: A and B
+/// (unless the kernel evaluates it) read once, C written once, then C copied back into A.
+usz solve_compulsory_bytes(solver_kind_t kind, mesh_t const* A);
+
+/// Returns the modelled number of memory reads per input point for one iteration of a kernel,
+/// assuming a tile's working set stays cached while it is processed but not across tiles.
+/// A value of 1.0 means every input point is read once.
+f64 solve_read_amplification(solver_kind_t kind, mesh_t const* A);
+
+/// Returns the modelled number of bytes one iteration of a kernel moves to/from memory: the
+/// compulsory traffic with its inputs read `solve_read_amplification` times.
+f64 solve_modelled_bytes(solver_kind_t kind, mesh_t const* A);
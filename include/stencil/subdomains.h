@@ -0,0 +1,67 @@
+#pragma once
+
+#include "stencil/comm_handler.h"
+#include "stencil/mesh.h"
+#include "stencil/mpi_compat.h"
+#include "stencil/solve.h"
+#include "types.h"
+
+/// Number of halo links of a sub-domain: one per direction a face travels in.
+#define SUBDOMAIN_NB_LINKS 6
+
+/// Over-decomposition of the block of a rank into slabs along X, each one a mesh with its own
+/// ghost cells. Neighbours along Y and Z share the X extent of the rank, so their slabs line up.
+///
+/// Faces between slabs of the same rank are copied directly, faces between ranks are
+/// exchanged with non-blocking messages. Each iteration advances first the slabs whose faces
+/// have all arrived, so a rank computes while the others are still in flight.
+typedef struct subdomains_s {
+    /// Number of slabs, 0 if over-decomposition is disabled.
+    usz nb;
+    /// First core plane of each slab in the core of the rank, `nb + 1` entries.
+    usz* x0;
+    mesh_t* A;
+    mesh_t* B;
+    mesh_t* C;
+    /// Peer of each link of each slab, `[s * SUBDOMAIN_NB_LINKS + l]`: a slab of this rank
+    /// (`local`), a rank (`remote`, its slab is `remote_slab`) or none (-1 in both).
+    i32* target_local;
+    i32* target_remote;
+    i32* source_local;
+    i32* source_remote;
+    i32* remote_slab;
+    /// Faces exchanged by each slab and link, doubled by iteration parity (`[p][s * 6 + l]`):
+    /// incoming faces, and outgoing ones still in flight to another rank.
+    f64** halo[2];
+    f64** send[2];
+    MPI_Request* recv_req[2];
+    MPI_Request* send_req[2];
+    usz* face_len;
+} subdomains_t;
+
+/// Splits the block of the rank into `nb` slabs along X, each one at least `STENCIL_ORDER`
+/// thick, and copies the constant coefficients of `B` into them.
+subdomains_t subdomains_new(comm_handler_t const* comm_handler, usz nb, mesh_t const* B);
+
+/// Releases the slabs.
+void subdomains_drop(subdomains_t* self);
+
+/// Copies the row-major meshes of the rank (ghost cells included) into the slabs.
+void subdomains_scatter(subdomains_t* self, mesh_t const* A, mesh_t const* C);
+
+/// Copies the current field of the slabs back into the row-major mesh `A` of the rank.
+void subdomains_gather(subdomains_t const* self, mesh_t* A);
+
+/// Computes `niter` Jacobi iterations with the selected kernel on every slab, recording after
+/// iteration `it` the value at the rank-local, ghost-inclusive coordinates `probes[p]` into
+/// `values[it * nb_probes + p]` (collective). `workspace` is sized for the block of the rank.
+void subdomains_run(
+    subdomains_t* self,
+    comm_handler_t const* comm_handler,
+    solver_kind_t kind,
+    solve_workspace_t const* workspace,
+    usz niter,
+    usz nb_probes,
+    usz const (*probes)[3],
+    f64* values
+);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "stencil/mpi_compat.h"
+#include "types.h"
+
+#include <omp.h>
+#include <stdbool.h>
+#include <time.h>
+
+/// Timed span recorded by a thread.
+typedef struct trace_event_s {
+    /// Event and category names, string literals.
+    char const* name;
+    char const* cat;
+    /// Name of the integer argument (e.g. "tile" or "peer"), `NULL` if there is none.
+    char const* arg_name;
+    i64 arg;
+    /// Local `CLOCK_MONOTONIC_RAW` timestamps in nanoseconds.
+    u64 begin_ns;
+    u64 end_ns;
+} trace_event_t;
+
+/// Events of one thread. Once full, the oldest events are overwritten.
+typedef struct trace_ring_s {
+    trace_event_t* events;
+    /// Events recorded so far, only the last `capacity` ones are kept.
+    usz len;
+} __attribute__((aligned(64))) trace_ring_t;
+
+/// Timeline tracer of the process, disabled unless `trace_init` was called.
+typedef struct trace_s {
+    bool enabled;
+    /// Events kept per thread.
+    usz capacity;
+    u32 nb_threads;
+    /// One ring per OpenMP thread, indexed by thread number.
+    trace_ring_t* rings;
+} trace_t;
+
+extern trace_t TRACE;
+
+/// Returns the current time of the tracing clock in nanoseconds.
+static inline u64 trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+/// Returns the start time of a span, 0 without a clock read when tracing is disabled.
+static inline u64 trace_begin(void) {
+    return TRACE.enabled ? trace_now() : 0;
+}
+
+/// Records a span started at `begin` into the ring of the calling thread.
+/// `arg_name` may be `NULL` when the event has no argument.
+static inline void trace_end(char const* cat, char const* name, char const* arg_name, i64 arg, u64 begin) {
+    if (!TRACE.enabled) {
+        return;
+    }
+    u32 const tid = (u32)omp_get_thread_num();
+    if (tid >= TRACE.nb_threads) {
+        return;
+    }
+    trace_ring_t* ring = &TRACE.rings[tid];
+    ring->events[ring->len % TRACE.capacity] = (trace_event_t){
+        .name = name,
+        .cat = cat,
+        .arg_name = arg_name,
+        .arg = arg,
+        .begin_ns = begin,
+        .end_ns = trace_now(),
+    };
+    ring->len += 1;
+}
+
+/// Allocates the rings of every thread of the current OpenMP team size, keeping `capacity`
+/// events per thread, and enables tracing.
+void trace_init(usz capacity);
+
+/// Disables tracing and releases the rings.
+void trace_drop(void);
+
+/// Aligns the clocks of all ranks on rank 0, gathers their events and writes them on rank 0 to
+/// `path` in Chrome trace-event format (collective).
+void trace_write(char const* path, MPI_Comm comm);
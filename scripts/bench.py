@@ -0,0 +1,327 @@
+#!/usr/bin/python3
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+from typing import Dict, List, Optional, Tuple
+
+
+Dims = Tuple[int, int, int]
+
+
+class RunResult:
+    def __init__(self, dims: Dims, size: Dims, ranks: int, threads: int, kernel: Optional[str],
+                 values: List[float], runtime: List[float]):
+        self.dims = dims
+        # Requested size: the whole mesh in strong scaling, the block of one rank in weak scaling
+        self.size = size
+        # None when the run uses the configured kernel
+        self.kernel = kernel
+        self.ranks = ranks
+        self.threads = threads
+        self.values = values
+        self.runtime = runtime
+        # None when there is no reference to validate against
+        self.valid: Optional[bool] = None
+        self.max_diff: Optional[float] = None
+        # (run, reference) iteration counts when they differ
+        self.length_mismatch: Optional[Tuple[int, int]] = None
+
+    @property
+    def cores(self) -> int:
+        return self.ranks * self.threads
+
+    @property
+    def time_per_iter(self) -> float:
+        # Median is less sensitive to the first (cold) iteration than the mean
+        return statistics.median(self.runtime)
+
+    def key(self) -> str:
+        key = f"{self.dims[0]}x{self.dims[1]}x{self.dims[2]}/r{self.ranks}/t{self.threads}"
+        return key if self.kernel is None else f"{key}/k{self.kernel}"
+
+
+def parse_dims(s: str) -> Dims:
+    parts = s.lower().split("x")
+    if len(parts) == 1:
+        return (int(parts[0]),) * 3
+    if len(parts) == 3:
+        return tuple(map(int, parts))
+    raise argparse.ArgumentTypeError(f"invalid mesh size `{s}`, expected N or XxYxZ")
+
+
+def parse_int_list(s: str) -> List[int]:
+    return [int(v) for v in s.split(",") if v]
+
+
+def parse_str_list(s: str) -> List[str]:
+    return [v for v in s.split(",") if v]
+
+
+def read_output(file_path: str) -> Tuple[List[float], List[float]]:
+    values, runtime = [], []
+    with open(file_path) as f:
+        for line in f:
+            cols = line.split()
+            if cols:
+                values.append(float(cols[0]))
+                runtime.append(float(cols[1]))
+    return values, runtime
+
+
+def run_once(args, dims: Dims, size: Dims, ranks: int, threads: int, kernel: Optional[str], workdir: str) -> RunResult:
+    tag = f"{dims[0]}x{dims[1]}x{dims[2]}_r{ranks}_t{threads}"
+    if kernel is not None:
+        tag += f"_k{kernel}"
+    config_path = os.path.join(workdir, f"config_{tag}.txt")
+    output_path = os.path.join(workdir, f"result_{tag}.txt")
+    with open(config_path, "w") as f:
+        f.write(f"dim_x={dims[0]}\ndim_y={dims[1]}\ndim_z={dims[2]}\nniter={args.niter}\n")
+        for extra in args.config:
+            f.write(extra + "\n")
+        if kernel is not None:
+            f.write(f"kernel={kernel}\n")
+
+    env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+    cmd = [args.mpirun, "-np", str(ranks)]
+    if args.oversubscribe:
+        cmd.append("--oversubscribe")
+    cmd += ["-x", "OMP_NUM_THREADS"] + args.mpirun_args.split()
+    cmd += [args.binary, config_path, output_path]
+
+    proc = subprocess.run(cmd, env=env, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if proc.returncode != 0:
+        raise RuntimeError(f"run {tag} failed with code {proc.returncode}:\n{proc.stderr}")
+
+    values, runtime = read_output(output_path)
+    if len(values) != args.niter:
+        raise RuntimeError(f"run {tag} produced {len(values)} iterations, expected {args.niter}")
+    return RunResult(dims, size, ranks, threads, kernel, values, runtime)
+
+
+def reference_path(reference_dir: str, dims: Dims, ranks: int) -> Optional[str]:
+    # Coefficients are built from rank-local indices, so results depend on the decomposition:
+    # references are keyed by mesh and rank count. Unsuffixed files are single-rank references.
+    name = f"result_{dims[0]}x{dims[1]}x{dims[2]}"
+    candidates = [f"{name}_r{ranks}.txt"] + ([f"{name}.txt"] if ranks == 1 else [])
+    for candidate in candidates:
+        path = os.path.join(reference_dir, candidate)
+        if os.path.exists(path):
+            return path
+    return None
+
+
+def validate(res: RunResult, reference_dir: str, tolerance: float) -> None:
+    ref_path = reference_path(reference_dir, res.dims, res.ranks)
+    if ref_path is None:
+        return
+    ref_values, _ = read_output(ref_path)
+    if len(ref_values) != len(res.values):
+        res.length_mismatch = (len(res.values), len(ref_values))
+        res.valid = False
+        return
+    res.max_diff = max(abs(a - b) for a, b in zip(ref_values, res.values))
+    res.valid = res.max_diff <= tolerance
+
+
+def write_reference(res: RunResult, reference_dir: str) -> None:
+    os.makedirs(reference_dir, exist_ok=True)
+    path = os.path.join(reference_dir, f"result_{res.dims[0]}x{res.dims[1]}x{res.dims[2]}_r{res.ranks}.txt")
+    with open(path, "w") as f:
+        for value, runtime in zip(res.values, res.runtime):
+            f.write(f"{value:+18.15f} {runtime:12.9f}\n")
+    print(f"wrote reference {path}", file=sys.stderr)
+
+
+def strong_scaling(results: List[RunResult]) -> Dict[str, float]:
+    # Efficiency relative to the smallest core count run on the same mesh and kernel: T0 * P0 / (T * P)
+    eff = {}
+    by_dims: Dict[Tuple[Dims, Optional[str]], List[RunResult]] = {}
+    for r in results:
+        by_dims.setdefault((r.dims, r.kernel), []).append(r)
+    for runs in by_dims.values():
+        base = min(runs, key=lambda r: (r.cores, r.ranks))
+        for r in runs:
+            eff[r.key()] = (base.time_per_iter * base.cores) / (r.time_per_iter * r.cores)
+    return eff
+
+
+def weak_scaling(results: List[RunResult]) -> Dict[str, float]:
+    # Work per core is constant, efficiency is T0 / T for each per-rank size, thread count and
+    # kernel (global dims grow with the rank count so they cannot be the key)
+    eff = {}
+    groups: Dict[Tuple[Dims, int, Optional[str]], List[RunResult]] = {}
+    for r in results:
+        groups.setdefault((r.size, r.threads, r.kernel), []).append(r)
+    for runs in groups.values():
+        base = min(runs, key=lambda r: r.ranks)
+        for r in runs:
+            eff[r.key()] = base.time_per_iter / r.time_per_iter
+    return eff
+
+
+def print_kernel_comparison(results: List[RunResult]) -> None:
+    # Same mesh and decomposition, one column per kernel and the fastest one
+    kernels = list(dict.fromkeys(r.kernel for r in results))
+    groups: Dict[Tuple[Dims, int, int], Dict[str, RunResult]] = {}
+    for r in results:
+        groups.setdefault((r.dims, r.ranks, r.threads), {})[r.kernel] = r
+    print()
+    print(f"{'run':<32} " + " ".join(f"{k:>12}" for k in kernels) + f" {'fastest':>12}")
+    for (dims, ranks, threads), runs in groups.items():
+        cells = [f"{runs[k].time_per_iter * 1e3:12.3f}" if k in runs else f"{'-':>12}" for k in kernels]
+        fastest = min(runs.values(), key=lambda r: r.time_per_iter).kernel
+        print(f"{dims[0]}x{dims[1]}x{dims[2]}/r{ranks}/t{threads}".ljust(32) + " " + " ".join(cells)
+              + f" {fastest:>12}")
+
+
+def git_revision() -> str:
+    try:
+        out = subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True, text=True)
+        return out.stdout.strip() or "unknown"
+    except OSError:
+        return "unknown"
+
+
+def load_history(path: str) -> List[dict]:
+    if not os.path.exists(path):
+        return []
+    with open(path) as f:
+        return [json.loads(line) for line in f if line.strip()]
+
+
+def previous_baseline(history: List[dict], mode: str, key: str, config: List[str]) -> Optional[dict]:
+    # Most recent validated entry of the same run on the same host, unvalidated runs are never
+    # used as a baseline
+    host = platform.node()
+    for entry in reversed(history):
+        if entry["mode"] == mode and entry["key"] == key and entry["host"] == host \
+                and entry["config"] == config and entry["valid"] is True:
+            return entry
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Strong/weak scaling study of the stencil with regression history.")
+    parser.add_argument("--binary", default="build/top-stencil", help="Path to the top-stencil executable")
+    parser.add_argument("--mode", choices=["strong", "weak"], default="strong",
+                        help="strong: fixed global mesh; weak: mesh grows along Z with the number of ranks")
+    parser.add_argument("--sizes", type=parse_dims, nargs="+", default=[parse_dims("100")],
+                        help="Global (strong) or per-rank (weak) mesh sizes, N or XxYxZ")
+    parser.add_argument("--ranks", type=parse_int_list, default=[1, 2, 4], help="Comma-separated MPI rank counts")
+    parser.add_argument("--threads", type=parse_int_list, default=[1], help="Comma-separated OpenMP thread counts")
+    parser.add_argument("--niter", type=int, default=10, help="Number of iterations per run")
+    parser.add_argument("--config", action="append", default=[], metavar="KEY=VALUE",
+                        help="Extra configuration line for every run (repeatable)")
+    parser.add_argument("--kernels", type=parse_str_list, default=[None],
+                        help="Comma-separated kernels to compare (e.g. blocked,streaming,split,matrix_free), "
+                             "default: the configured one")
+    parser.add_argument("--reference-dir", default=os.path.join(os.path.dirname(__file__), "..", "reference"))
+    parser.add_argument("--write-references", action="store_true",
+                        help="Store the results of runs without a reference as the reference of their mesh and "
+                             "rank count (run with the baseline binary)")
+    parser.add_argument("--tolerance", type=float, default=1e-12, help="Maximum absolute difference to reference")
+    parser.add_argument("--history", default="bench_history.jsonl", help="History store (one JSON record per run)")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="Relative slowdown against the previous baseline flagged as regression")
+    parser.add_argument("--no-record", action="store_true", help="Do not append results to the history store")
+    parser.add_argument("--mpirun", default="mpirun")
+    parser.add_argument("--no-oversubscribe", dest="oversubscribe", action="store_false")
+    parser.add_argument("--mpirun-args", default="", help="Extra arguments passed to mpirun")
+    args = parser.parse_args()
+
+    history = load_history(args.history)
+    results: List[RunResult] = []
+    with tempfile.TemporaryDirectory(prefix="stencil-bench-") as workdir:
+        for size in args.sizes:
+            for ranks in args.ranks:
+                dims = size if args.mode == "strong" else (size[0], size[1], size[2] * ranks)
+                for threads in args.threads:
+                    for kernel in args.kernels:
+                        res = run_once(args, dims, size, ranks, threads, kernel, workdir)
+                        validate(res, args.reference_dir, args.tolerance)
+                        if res.valid is None and args.write_references:
+                            write_reference(res, args.reference_dir)
+                            validate(res, args.reference_dir, args.tolerance)
+                        results.append(res)
+                        print(f"ran {res.key():<32} {res.time_per_iter * 1e3:10.3f} ms/iter", file=sys.stderr)
+
+    efficiency = strong_scaling(results) if args.mode == "strong" else weak_scaling(results)
+
+    failures, regressions, ungated = 0, 0, 0
+    revision = git_revision()
+    timestamp = datetime.datetime.now().isoformat(timespec="seconds")
+    print(f"{'run':<32} {'ms/iter':>10} {'eff':>7} {'check':>14} {'baseline':>10} {'delta':>8}")
+    records = []
+    for r in results:
+        if r.valid is None:
+            check = "not gated"
+            ungated += 1
+        elif r.valid:
+            check = "ok"
+        else:
+            if r.length_mismatch is not None:
+                reason = f"FAIL {r.length_mismatch[0]}/{r.length_mismatch[1]} it"
+            else:
+                reason = f"FAIL {r.max_diff:.1e}"
+            check = f"\x1b[31m{reason:>14}\x1b[0m"
+            failures += 1
+
+        baseline = previous_baseline(history, args.mode, r.key(), args.config)
+        base_str, delta_str = "-", "-"
+        if baseline is not None:
+            delta = r.time_per_iter / baseline["time_per_iter"] - 1.0
+            base_str = f"{baseline['time_per_iter'] * 1e3:.3f}"
+            delta_str = f"{delta * 100:+.1f}%"
+            if delta > args.threshold:
+                delta_str = f"\x1b[31m{delta_str:>8}\x1b[0m"
+                regressions += 1
+
+        print(f"{r.key():<32} {r.time_per_iter * 1e3:10.3f} {efficiency[r.key()]:7.2f} {check:>14} "
+              f"{base_str:>10} {delta_str:>8}")
+        records.append({
+            "timestamp": timestamp,
+            "revision": revision,
+            "host": platform.node(),
+            "mode": args.mode,
+            "key": r.key(),
+            "config": args.config,
+            "dims": list(r.dims),
+            "ranks": r.ranks,
+            "threads": r.threads,
+            "kernel": r.kernel,
+            "niter": args.niter,
+            "time_per_iter": r.time_per_iter,
+            "efficiency": efficiency[r.key()],
+            "valid": r.valid,
+            "max_diff": r.max_diff,
+        })
+
+    if len(args.kernels) > 1:
+        print_kernel_comparison(results)
+
+    # Failed and unvalidated runs are recorded too, but never used as a baseline
+    if not args.no_record:
+        with open(args.history, "a") as f:
+            for record in records:
+                f.write(json.dumps(record) + "\n")
+
+    if ungated:
+        print(f"\x1b[1;33mwarning:\x1b[0m {ungated} run(s) have no reference for their mesh and rank count "
+              f"and were not gated, see --write-references", file=sys.stderr)
+    if failures:
+        print(f"\x1b[1;31merror:\x1b[0m {failures} run(s) diverge from the reference", file=sys.stderr)
+    if regressions:
+        print(f"\x1b[1;31merror:\x1b[0m {regressions} run(s) regressed by more than "
+              f"{args.threshold * 100:.1f}% against the previous baseline", file=sys.stderr)
+    sys.exit(1 if failures or regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
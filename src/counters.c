@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+
+#include "counters.h"
+
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// Description of a hardware event backing a counter.
+typedef struct event_desc_s {
+    counter_t counter;
+    u32 type;
+    u64 config;
+    f64 weight;
+} event_desc_t;
+
+static event_desc_t const GENERIC_EVENTS[] = {
+    { COUNTER_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1.0 },
+    { COUNTER_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1.0 },
+    { COUNTER_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1.0 },
+};
+
+/// Intel FP_ARITH_INST_RETIRED.{SCALAR,128B_PACKED,256B_PACKED,512B_PACKED}_DOUBLE.
+static event_desc_t const INTEL_FP_EVENTS[] = {
+    { COUNTER_FLOPS, PERF_TYPE_RAW, 0x01c7, 1.0 },
+    { COUNTER_FLOPS, PERF_TYPE_RAW, 0x04c7, 2.0 },
+    { COUNTER_FLOPS, PERF_TYPE_RAW, 0x10c7, 4.0 },
+    { COUNTER_FLOPS, PERF_TYPE_RAW, 0x40c7, 8.0 },
+};
+
+/// AMD Zen RETIRED_SSE_AVX_FLOPS (all types, already counts FLOPs).
+static event_desc_t const AMD_FP_EVENTS[] = {
+    { COUNTER_FLOPS, PERF_TYPE_RAW, 0xff03, 1.0 },
+};
+
+static char const* COUNTERS_STR[] = {
+    "cycles",
+    "instructions",
+    "llc-misses",
+    "flops",
+};
+
+char const* counter_as_str(counter_t counter) {
+    return COUNTERS_STR[(usz)counter];
+}
+
+/// Returns the CPU vendor string from `/proc/cpuinfo` (empty if unknown).
+static void cpu_vendor(char vendor[static 32]) {
+    vendor[0] = '\0';
+    FILE* fp = fopen("/proc/cpuinfo", "rb");
+    if (NULL == fp) {
+        return;
+    }
+    char line[256];
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        if (1 == sscanf(line, "vendor_id : %31s", vendor)) {
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static i32 perf_event_open(u32 type, u64 config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Calling thread, any CPU
+    return (i32)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool counters_init(counters_t* self) {
+    char vendor[32];
+    cpu_vendor(vendor);
+    event_desc_t const* fp_events = NULL;
+    usz nb_fp_events = 0;
+    if (strcmp("GenuineIntel", vendor) == 0) {
+        fp_events = INTEL_FP_EVENTS;
+        nb_fp_events = countof(INTEL_FP_EVENTS);
+    } else if (strcmp("AuthenticAMD", vendor) == 0) {
+        fp_events = AMD_FP_EVENTS;
+        nb_fp_events = countof(AMD_FP_EVENTS);
+    }
+
+    u32 const nb_events = (u32)(countof(GENERIC_EVENTS) + nb_fp_events);
+    u32 const nb_threads = (u32)omp_get_max_threads();
+    *self = (counters_t){
+        .nb_threads = nb_threads,
+        .nb_events = nb_events,
+        .fd = malloc(sizeof(i32) * nb_threads * nb_events),
+        .event_counter = malloc(sizeof(counter_t) * nb_events),
+        .event_weight = malloc(sizeof(f64) * nb_events),
+    };
+
+    event_desc_t events[nb_events];
+    memcpy(events, GENERIC_EVENTS, sizeof(GENERIC_EVENTS));
+    if (nb_fp_events > 0) {
+        memcpy(&events[countof(GENERIC_EVENTS)], fp_events, sizeof(event_desc_t) * nb_fp_events);
+    }
+    for (u32 e = 0; e < nb_events; ++e) {
+        self->event_counter[e] = events[e].counter;
+        self->event_weight[e] = events[e].weight;
+    }
+
+    // Events are bound to the thread that opens them: open them from inside the team that runs
+    // the kernels (libgomp keeps the same threads alive between parallel regions)
+    #pragma omp parallel num_threads(nb_threads)
+    {
+        u32 const t = (u32)omp_get_thread_num();
+        for (u32 e = 0; e < nb_events; ++e) {
+            self->fd[t * nb_events + e] = perf_event_open(events[e].type, events[e].config);
+        }
+    }
+
+    bool any = false;
+    for (u32 e = 0; e < nb_events; ++e) {
+        bool ok = true;
+        for (u32 t = 0; t < nb_threads; ++t) {
+            ok = ok && self->fd[t * nb_events + e] >= 0;
+        }
+        if (!ok) {
+            // Only keep events that count on every thread
+            for (u32 t = 0; t < nb_threads; ++t) {
+                if (self->fd[t * nb_events + e] >= 0) {
+                    close(self->fd[t * nb_events + e]);
+                    self->fd[t * nb_events + e] = -1;
+                }
+            }
+            if (COUNTER_FLOPS == events[e].counter) {
+                // A missing vector width would under-count FLOPs
+                for (u32 f = 0; f < nb_events; ++f) {
+                    if (COUNTER_FLOPS == events[f].counter) {
+                        for (u32 t = 0; t < nb_threads; ++t) {
+                            if (self->fd[t * nb_events + f] >= 0) {
+                                close(self->fd[t * nb_events + f]);
+                                self->fd[t * nb_events + f] = -1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (u32 e = 0; e < nb_events; ++e) {
+        if (self->fd[e] >= 0) {
+            self->available[events[e].counter] = true;
+            any = true;
+        }
+    }
+
+    return any;
+}
+
+void counters_drop(counters_t* self) {
+    for (u32 i = 0; i < self->nb_threads * self->nb_events; ++i) {
+        if (self->fd[i] >= 0) {
+            close(self->fd[i]);
+        }
+    }
+    free(self->fd);
+    free(self->event_counter);
+    free(self->event_weight);
+    *self = (counters_t){ 0 };
+}
+
+void counters_read(counters_t const* self, f64 value[static COUNTER_COUNT]) {
+    for (usz c = 0; c < COUNTER_COUNT; ++c) {
+        value[c] = 0.0;
+    }
+
+    for (u32 t = 0; t < self->nb_threads; ++t) {
+        for (u32 e = 0; e < self->nb_events; ++e) {
+            i32 const fd = self->fd[t * self->nb_events + e];
+            if (fd < 0) {
+                continue;
+            }
+            // { value, time_enabled, time_running }
+            u64 buf[3];
+            if (sizeof(buf) != read(fd, buf, sizeof(buf)) || 0 == buf[2]) {
+                continue;
+            }
+            f64 const scale = (f64)buf[1] / (f64)buf[2];
+            value[self->event_counter[e]] += (f64)buf[0] * scale * self->event_weight[e];
+        }
+    }
+}
+
+counters_region_t counters_region_new(char const* name) {
+    return (counters_region_t){
+        .name = name,
+    };
+}
+
+void counters_region_start(counters_t const* self, counters_region_t* region) {
+    if (NULL != self && self->nb_threads > 0) {
+        counters_read(self, region->begin);
+    }
+    chrono_start(&region->chrono);
+}
+
+void counters_region_stop(counters_t const* self, counters_region_t* region) {
+    chrono_stop(&region->chrono);
+    region->secs += duration_as_s_f64(chrono_elapsed(region->chrono));
+    if (NULL != self && self->nb_threads > 0) {
+        f64 end[COUNTER_COUNT];
+        counters_read(self, end);
+        for (usz c = 0; c < COUNTER_COUNT; ++c) {
+            region->value[c] += end[c] - region->begin[c];
+        }
+    }
+}
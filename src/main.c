@@ -1,62 +1,43 @@
 #include "chrono.h"
 #include "logging.h"
-#include "stencil/comm_handler.h"
+#include "stencil/affinity.h"
 #include "stencil/config.h"
-#include "stencil/init.h"
-#include "stencil/mesh.h"
-#include "stencil/solve.h"
+#include "stencil/mpi_compat.h"
+#include "stencil/placement.h"
+#include "stencil/receivers.h"
+#include "stencil/session.h"
 
-#include <mpi.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static char* DEFAULT_CONFIG_PATH = "config.txt";
 static char* DEFAULT_OUTPUT_PATH = NULL;
 
 static void save_results(
     FILE ofp[static 1],
-    config_t const* cfg,
-    mesh_t const* mesh,
-    comm_handler_t const* comm_handler,
-    duration_t elapsed
+    session_t const* session,
+    bool owned,
+    f64 value,
+    f64 elapsed_s
 ) {
-    usz const mid_x = cfg->dim_x / 2;
-    usz const mid_y = cfg->dim_y / 2;
-    usz const mid_z = cfg->dim_z / 2;
-    bool mid_x_is_in =
-        (comm_handler->coord_x <= mid_x && mid_x < comm_handler->coord_x + comm_handler->loc_dim_x)
-            ? true
-            : false;
-    bool mid_y_is_in =
-        (comm_handler->coord_y <= mid_y && mid_y < comm_handler->coord_y + comm_handler->loc_dim_y)
-            ? true
-            : false;
-    bool mid_z_is_in =
-        (comm_handler->coord_z <= mid_z && mid_z < comm_handler->coord_z + comm_handler->loc_dim_z)
-            ? true
-            : false;
-
-    f64 loc_elapsed_s = duration_as_s_f64(elapsed);
-    f64 loc_ns_per_elem =
-        duration_as_ns_f64(elapsed) / (f64)cfg->dim_x / (f64)cfg->dim_y / (f64)cfg->dim_z;
+    config_t const* cfg = &session->cfg;
+
+    f64 loc_elapsed_s = elapsed_s;
+    f64 loc_ns_per_elem = elapsed_s * 1.0e+9 / (f64)cfg->dim_x / (f64)cfg->dim_y / (f64)cfg->dim_z;
     f64 glob_elapsed_s;
     f64 glob_ns_per_elem;
 
-    i32 rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    i32 comm_size;
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
-    MPI_Allreduce(&loc_elapsed_s, &glob_elapsed_s, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(&loc_ns_per_elem, &glob_ns_per_elem, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-
-    if (mid_x_is_in && mid_y_is_in && mid_z_is_in) {
-        f64(*restrict span_value)[mesh->dim_y][mesh->dim_z] = (f64(*)[mesh->dim_y][mesh->dim_z])mesh->value;
+    MPI_Comm const comm = session->comm_handler.comm;
+    i32 const comm_size = session->comm_size;
+    MPI_Allreduce(&loc_elapsed_s, &glob_elapsed_s, 1, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(&loc_ns_per_elem, &glob_ns_per_elem, 1, MPI_DOUBLE, MPI_SUM, comm);
 
+    if (owned) {
         fprintf(
             ofp,
             "%+18.15lf %12.9lf %12.3lf %zu %zu %zu\n",
-            span_value[mid_x - comm_handler->coord_x + STENCIL_ORDER]
-                       [mid_y - comm_handler->coord_y + STENCIL_ORDER]
-                       [mid_z - comm_handler->coord_z + STENCIL_ORDER],
+            value,
             glob_elapsed_s / (f64)comm_size,
             glob_ns_per_elem / (f64)comm_size,
             cfg->dim_x,
@@ -67,23 +48,20 @@ static void save_results(
 }
 
 i32 main(i32 argc, char* argv[argc + 1]) {
-    MPI_Init(&argc, &argv);
+    // Task mode issues MPI calls from OpenMP tasks, one at a time
+    i32 provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
 
     i32 rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    i32 comm_size;
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
 
-    char* config_path;
-    char* output_path;
+    char* config_path = DEFAULT_CONFIG_PATH;
+    char* output_path = DEFAULT_OUTPUT_PATH;
     if (2 == argc) {
         config_path = argv[1];
     } else if (3 == argc) {
         config_path = argv[1];
         output_path = argv[2];
-    } else {
-        config_path = DEFAULT_CONFIG_PATH;
-        output_path = DEFAULT_OUTPUT_PATH;
     }
     config_t cfg = config_parse_from_file(config_path);
 #ifndef NDEBUG
@@ -102,27 +80,54 @@ i32 main(i32 argc, char* argv[argc + 1]) {
         ofp = stdout;
     }
 
-    comm_handler_t comm_handler =
-        comm_handler_new((u32)rank, (u32)comm_size, cfg.dim_x, cfg.dim_y, cfg.dim_z);
+    // Place ranks and threads before the meshes are first touched
+    affinity_t affinity = { 0 };
+    if (cfg.affinity) {
+        affinity = affinity_setup(MPI_COMM_WORLD);
+    }
+
+    // Renumber ranks before the process grid is laid out on them
+    placement_t placement = { .comm = MPI_COMM_WORLD };
+    if (cfg.reorder) {
+        placement = placement_new(MPI_COMM_WORLD, cfg.dim_x, cfg.dim_y, cfg.dim_z, cfg.node_size);
+        placement_print(&placement);
+    }
+
+    session_t session = session_new(&cfg, placement.comm);
 #ifndef NDEBUG
-    comm_handler_print(&comm_handler);
+    comm_handler_print(&session.comm_handler);
+    if (cfg.affinity) {
+        affinity_print(&affinity);
+    }
 #endif
 
-    mesh_t A = mesh_new(
-        comm_handler.loc_dim_x, comm_handler.loc_dim_y, comm_handler.loc_dim_z, MESH_KIND_INPUT
-    );
-    mesh_t B = mesh_new(
-        comm_handler.loc_dim_x, comm_handler.loc_dim_y, comm_handler.loc_dim_z, MESH_KIND_CONSTANT
-    );
-    mesh_t C = mesh_new(
-        comm_handler.loc_dim_x, comm_handler.loc_dim_y, comm_handler.loc_dim_z, MESH_KIND_OUTPUT
-    );
-    init_meshes(&A, &B, &C, &comm_handler);
-
-    // Exchange ghost cells to make sure data is properly initialized everywhere
-    comm_handler_ghost_exchange(&comm_handler, &A);
-    comm_handler_ghost_exchange(&comm_handler, &B);
-    comm_handler_ghost_exchange(&comm_handler, &C);
+    receivers_t receivers = { 0 };
+    bool const use_receivers = '\0' != cfg.receivers_file[0];
+    if (use_receivers) {
+        receivers = receivers_new(
+            cfg.receivers_file, cfg.seismogram_file, cfg.seismogram_chunk, &session.comm_handler
+        );
+    }
+
+    // Sampled points: the mesh centre if owned, then the local receivers
+    usz const mid[3] = { cfg.dim_x / 2, cfg.dim_y / 2, cfg.dim_z / 2 };
+    f64 mid_value;
+    bool const owned = session_probe_local(&session, mid[0], mid[1], mid[2], &mid_value);
+    usz const first_receiver = owned ? 1 : 0;
+    usz const nb_points = first_receiver + receivers.nb_local;
+    usz(*points)[3] = malloc(sizeof(usz[3]) * (nb_points > 0 ? nb_points : 1));
+    if (owned) {
+        memcpy(points[0], mid, sizeof(mid));
+    }
+    if (receivers.nb_local > 0) {
+        memcpy(points[first_receiver], receivers.points, sizeof(usz[3]) * receivers.nb_local);
+    }
+
+    // Iterations overlap in task mode and across sub-domains: run them in one call and report
+    // the average time
+    bool const overlapped = EXEC_MODE_TASKS == session.cfg.exec || session.subdomains.nb > 0;
+    usz const chunk = overlapped ? cfg.niter : 1;
+    f64* values = malloc(sizeof(f64) * (chunk > 0 ? chunk : 1) * (nb_points > 0 ? nb_points : 1));
 
     chrono_t chrono;
 #ifndef NDEBUG
@@ -130,30 +135,39 @@ i32 main(i32 argc, char* argv[argc + 1]) {
         fprintf(stderr, "****************************************\n");
     }
 #endif
-    for (usz it = 0; it < cfg.niter; ++it) {
+    for (usz it = 0; it < cfg.niter; it += chunk) {
 #ifndef NDEBUG
         if (rank == 0) {
-            fprintf(stderr, "Iteration #%2zu/%2zu\r", it + 1, cfg.niter);
+            fprintf(stderr, "Iteration #%2zu/%2zu\r", it + chunk, cfg.niter);
         }
 #endif
 
         chrono_start(&chrono);
-        // Compute Jacobi C=B@A (one iteration)
-        solve_jacobi(&A, &B, &C);
-
-        // Exchange ghost cells for A and C meshes
-        // No need to exchange B as its a constant mesh
-        comm_handler_ghost_exchange(&comm_handler, &A);
-        comm_handler_ghost_exchange(&comm_handler, &C);
+        session_step_probed(&session, chunk, nb_points, (usz const(*)[3])points, values);
         chrono_stop(&chrono);
 
-        duration_t elapsed = chrono_elapsed(chrono);
-        save_results(ofp, &cfg, &A, &comm_handler, elapsed);
+        f64 const elapsed_s = duration_as_s_f64(chrono_elapsed(chrono)) / (f64)chunk;
+        for (usz c = 0; c < chunk; ++c) {
+            f64 const* step_values = &values[c * nb_points];
+            save_results(ofp, &session, owned, step_values[0], elapsed_s);
+            if (use_receivers) {
+                receivers_record(&receivers, &step_values[first_receiver]);
+            }
+        }
+    }
+    free(values);
+    free(points);
+    if (use_receivers) {
+        receivers_drop(&receivers);
     }
 
-    mesh_drop(&A);
-    mesh_drop(&B);
-    mesh_drop(&C);
+    session_report(&session);
+
+    session_drop(&session);
+    affinity_drop(&affinity);
+    if (cfg.reorder) {
+        placement_drop(&placement);
+    }
     fclose(ofp);
 
     MPI_Finalize();
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include "stencil/affinity.h"
+
+#include "logging.h"
+
+#include <dirent.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PATH_LEN 128UL
+
+/// Reads an integer from a sysfs file, returns `fallback` if it does not exist.
+static i32 read_sys_i32(char const* path, i32 fallback) {
+    FILE* fp = fopen(path, "rb");
+    if (NULL == fp) {
+        return fallback;
+    }
+    i32 value;
+    if (1 != fscanf(fp, "%d", &value)) {
+        value = fallback;
+    }
+    fclose(fp);
+    return value;
+}
+
+/// Returns the NUMA node of a CPU (the `nodeN` entry of its sysfs directory), 0 if unknown.
+static i32 cpu_numa_node(i32 cpu) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if (NULL == dir) {
+        return 0;
+    }
+    i32 node = 0;
+    struct dirent* entry;
+    while (NULL != (entry = readdir(dir))) {
+        if (1 == sscanf(entry->d_name, "node%d", &node)) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+static cpu_topology_t cpu_topology(i32 cpu) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    i32 const package = read_sys_i32(path, 0);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    i32 const core = read_sys_i32(path, cpu);
+    // Without an L3 description, consider the whole package as one domain
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index3/id", cpu);
+    i32 const l3 = read_sys_i32(path, package);
+
+    return (cpu_topology_t){
+        .cpu = cpu,
+        .package = package,
+        .numa_node = cpu_numa_node(cpu),
+        .l3 = l3,
+        .core = core,
+    };
+}
+
+/// Orders CPUs so that cores sharing a socket, a NUMA node and an L3 cache are contiguous,
+/// and hyperthreads of a core are adjacent.
+static i32 cpu_topology_cmp(void const* lhs, void const* rhs) {
+    cpu_topology_t const* a = lhs;
+    cpu_topology_t const* b = rhs;
+    i32 const ka[] = { a->package, a->numa_node, a->l3, a->core, a->cpu };
+    i32 const kb[] = { b->package, b->numa_node, b->l3, b->core, b->cpu };
+    for (usz i = 0; i < countof(ka); ++i) {
+        if (ka[i] != kb[i]) {
+            return ka[i] < kb[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static bool same_core(cpu_topology_t const* a, cpu_topology_t const* b) {
+    return a->package == b->package && a->core == b->core;
+}
+
+affinity_t affinity_setup(MPI_Comm comm) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    i32 local_rank;
+    MPI_Comm_rank(node_comm, &local_rank);
+    i32 local_size;
+    MPI_Comm_size(node_comm, &local_size);
+
+    // CPUs usable on the node: union of what the launcher gave to every local rank
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    MPI_Allreduce(
+        MPI_IN_PLACE,
+        &allowed,
+        (i32)(sizeof(allowed) / sizeof(unsigned long)),
+        MPI_UNSIGNED_LONG,
+        MPI_BOR,
+        node_comm
+    );
+    MPI_Comm_free(&node_comm);
+
+    u32 const nb_cpus = (u32)CPU_COUNT(&allowed);
+    cpu_topology_t* topo = malloc(sizeof(cpu_topology_t) * nb_cpus);
+    u32 n = 0;
+    for (i32 cpu = 0; cpu < CPU_SETSIZE && n < nb_cpus; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            topo[n++] = cpu_topology(cpu);
+        }
+    }
+    qsort(topo, nb_cpus, sizeof(cpu_topology_t), cpu_topology_cmp);
+
+    // Index of the first hardware thread of each physical core
+    u32* core_first = malloc(sizeof(u32) * (nb_cpus + 1));
+    u32 nb_cores = 0;
+    u32 nb_packages = 0, nb_numa_nodes = 0, nb_l3 = 0;
+    for (u32 c = 0; c < nb_cpus; ++c) {
+        if (0 == c || !same_core(&topo[c - 1], &topo[c])) {
+            core_first[nb_cores++] = c;
+        }
+        nb_packages += (0 == c || topo[c - 1].package != topo[c].package);
+        nb_numa_nodes += (0 == c || topo[c - 1].numa_node != topo[c].numa_node);
+        nb_l3 += (0 == c || topo[c - 1].l3 != topo[c].l3 || topo[c - 1].package != topo[c].package);
+    }
+    core_first[nb_cores] = nb_cpus;
+
+    // Contiguous core ranges, the first `nb_cores % local_size` ranks taking one extra core so
+    // that none is left idle. Ranks share cores only when oversubscribing.
+    u32 first_core, rank_cores;
+    if (nb_cores >= (u32)local_size) {
+        u32 const share = nb_cores / (u32)local_size;
+        u32 const extra = nb_cores % (u32)local_size;
+        u32 const lr = (u32)local_rank;
+        rank_cores = share + (lr < extra ? 1 : 0);
+        first_core = lr * share + (lr < extra ? lr : extra);
+    } else {
+        rank_cores = 1;
+        first_core = (u32)local_rank % nb_cores;
+    }
+
+    affinity_t self = {
+        .rank = rank,
+        .local_rank = (u32)local_rank,
+        .local_size = (u32)local_size,
+        .nb_packages = nb_packages,
+        .nb_numa_nodes = nb_numa_nodes,
+        .nb_l3 = nb_l3,
+        .nb_cores = nb_cores,
+    };
+    CPU_ZERO(&self.rank_set);
+    for (u32 core = first_core; core < first_core + rank_cores; ++core) {
+        for (u32 c = core_first[core]; c < core_first[core + 1]; ++c) {
+            CPU_SET(topo[c].cpu, &self.rank_set);
+        }
+    }
+    // Threads created from now on inherit the mask of the rank
+    if (0 != sched_setaffinity(0, sizeof(self.rank_set), &self.rank_set)) {
+        warn("rank %d: failed to bind to its cores", rank);
+    }
+
+    // One thread per physical core unless the user asked otherwise
+    if (NULL == getenv("OMP_NUM_THREADS")) {
+        omp_set_num_threads((i32)rank_cores);
+    }
+    self.nb_threads = (u32)omp_get_max_threads();
+    self.thread_cpu = malloc(sizeof(cpu_topology_t) * self.nb_threads);
+    for (u32 t = 0; t < self.nb_threads; ++t) {
+        self.thread_cpu[t] = topo[core_first[first_core + t % rank_cores]];
+    }
+
+    // Explicit OpenMP places take precedence over automatic pinning
+    if (NULL == getenv("OMP_PLACES")) {
+        #pragma omp parallel num_threads(self.nb_threads)
+        {
+            cpu_set_t thread_set;
+            CPU_ZERO(&thread_set);
+            CPU_SET(self.thread_cpu[omp_get_thread_num()].cpu, &thread_set);
+            sched_setaffinity(0, sizeof(thread_set), &thread_set);
+        }
+    }
+
+    free(core_first);
+    free(topo);
+    return self;
+}
+
+void affinity_drop(affinity_t* self) {
+    free(self->thread_cpu);
+    self->thread_cpu = NULL;
+}
+
+void affinity_print(affinity_t const* self) {
+    char threads[1024] = "";
+    usz len = 0;
+    for (u32 t = 0; t < self->nb_threads && len < sizeof(threads); ++t) {
+        cpu_topology_t const* c = &self->thread_cpu[t];
+        len += (usz)snprintf(
+            threads + len,
+            sizeof(threads) - len,
+            "%s%u:cpu%d(s%d,n%d,l%d)",
+            0 == t ? "" : " ",
+            t,
+            c->cpu,
+            c->package,
+            c->numa_node,
+            c->l3
+        );
+    }
+
+    fprintf(
+        stderr,
+        "****************************************\n"
+        "RANK %d PLACEMENT:\n"
+        "  NODE RANK:  %u/%u\n"
+        "  NODE:       %u socket(s), %u NUMA node(s), %u L3 domain(s), %u core(s)\n"
+        "  RANK CPUS:  %d\n"
+        "  THREADS:    %s\n",
+        self->rank,
+        self->local_rank,
+        self->local_size,
+        self->nb_packages,
+        self->nb_numa_nodes,
+        self->nb_l3,
+        self->nb_cores,
+        CPU_COUNT(&self->rank_set),
+        threads
+    );
+}
@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+
+#include "stencil/coef_cache.h"
+
+#include "logging.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define COEF_CACHE_MAGIC "STNCLB02"
+/// Values start one (huge-page friendly) page after the header.
+#define COEF_CACHE_DATA_OFFSET 4096UL
+#define MAX_PATH_LEN 512UL
+/// Spans of values checked on a hit (evenly spread over the mesh) and their length in values.
+#define COEF_CACHE_SAMPLES 64UL
+#define COEF_CACHE_SAMPLE_LEN 64UL
+
+typedef struct coef_cache_header_s {
+    char magic[8];
+    u64 stencil_order;
+    u64 dim_x;
+    u64 dim_y;
+    u64 dim_z;
+    u64 nb_x;
+    u64 nb_y;
+    u64 nb_z;
+    u64 coord_x;
+    u64 coord_y;
+    u64 coord_z;
+    /// Dimensions of the stored mesh (ghost cells included).
+    u64 mesh_dim_x;
+    u64 mesh_dim_y;
+    u64 mesh_dim_z;
+    /// Checksum of all the values, only checked with `coef_cache_verify=1`.
+    u64 checksum;
+    /// Checksum of the sampled spans of values.
+    u64 sample_checksum;
+    /// Checksum of the header itself, this field excluded.
+    u64 header_checksum;
+} coef_cache_header_t;
+
+_Static_assert(sizeof(coef_cache_header_t) <= COEF_CACHE_DATA_OFFSET, "cache header too large");
+
+static coef_cache_header_t coef_cache_header(
+    config_t const* cfg, comm_handler_t const* comm_handler, usz mesh_dim_x, usz mesh_dim_y, usz mesh_dim_z
+) {
+    coef_cache_header_t header = {
+        .stencil_order = STENCIL_ORDER,
+        .dim_x = cfg->dim_x,
+        .dim_y = cfg->dim_y,
+        .dim_z = cfg->dim_z,
+        .nb_x = comm_handler->nb_x,
+        .nb_y = comm_handler->nb_y,
+        .nb_z = comm_handler->nb_z,
+        .coord_x = comm_handler->coord_x,
+        .coord_y = comm_handler->coord_y,
+        .coord_z = comm_handler->coord_z,
+        .mesh_dim_x = mesh_dim_x,
+        .mesh_dim_y = mesh_dim_y,
+        .mesh_dim_z = mesh_dim_z,
+        .checksum = 0,
+        .sample_checksum = 0,
+        .header_checksum = 0,
+    };
+    memcpy(header.magic, COEF_CACHE_MAGIC, sizeof(header.magic));
+    return header;
+}
+
+static void coef_cache_path(
+    char path[static MAX_PATH_LEN], char const* dir, config_t const* cfg, comm_handler_t const* comm_handler
+) {
+    snprintf(
+        path,
+        MAX_PATH_LEN,
+        "%s/B_%zux%zux%zu_o%lu_p%ux%ux%u_c%u-%u-%u.bin",
+        dir,
+        cfg->dim_x,
+        cfg->dim_y,
+        cfg->dim_z,
+        STENCIL_ORDER,
+        comm_handler->nb_x,
+        comm_handler->nb_y,
+        comm_handler->nb_z,
+        comm_handler->coord_x,
+        comm_handler->coord_y,
+        comm_handler->coord_z
+    );
+}
+
+/// 64-bit multiplicative hash of the bit patterns, over 4 independent lanes so that it runs
+/// at memory speed rather than at the latency of the multiplication.
+static u64 coef_cache_checksum(f64 const* value, usz len) {
+    u64 const prime = 0x100000001b3UL;
+    u64 lane[4] = { 0xcbf29ce484222325UL, 0x84222325cbf29ce4UL, 0x9ce484222325cbf2UL, 0x2325cbf29ce48422UL };
+    u64 const* words = (u64 const*)value;
+    usz const body = len - len % 4;
+    for (usz i = 0; i < body; i += 4) {
+        for (usz l = 0; l < 4; ++l) {
+            lane[l] = (lane[l] ^ words[i + l]) * prime;
+        }
+    }
+    for (usz l = 0; l < len % 4; ++l) {
+        lane[l] = (lane[l] ^ words[body + l]) * prime;
+    }
+    return ((lane[0] * prime ^ lane[1]) * prime ^ lane[2]) * prime ^ lane[3];
+}
+
+/// Checksum of `COEF_CACHE_SAMPLES` spans spread over the values, so that a hit only touches a
+/// few pages of the entry while a truncated or partly overwritten file is still caught.
+static u64 coef_cache_sample_checksum(f64 const* value, usz len) {
+    if (len <= COEF_CACHE_SAMPLES * COEF_CACHE_SAMPLE_LEN) {
+        return coef_cache_checksum(value, len);
+    }
+    usz const stride = (len - COEF_CACHE_SAMPLE_LEN) / (COEF_CACHE_SAMPLES - 1);
+    u64 sums[COEF_CACHE_SAMPLES];
+    for (usz s = 0; s < COEF_CACHE_SAMPLES; ++s) {
+        sums[s] = coef_cache_checksum(value + s * stride, COEF_CACHE_SAMPLE_LEN);
+    }
+    return coef_cache_checksum((f64 const*)sums, COEF_CACHE_SAMPLES);
+}
+
+static u64 coef_cache_header_checksum(coef_cache_header_t header) {
+    header.header_checksum = 0;
+    return coef_cache_checksum((f64 const*)&header, sizeof(header) / sizeof(u64));
+}
+
+bool coef_cache_map(
+    char const* dir, config_t const* cfg, comm_handler_t const* comm_handler, mesh_t* mesh
+) {
+    char path[MAX_PATH_LEN];
+    coef_cache_path(path, dir, cfg, comm_handler);
+
+    i32 fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    usz const mesh_dim_x = comm_handler->loc_dim_x + 2 * STENCIL_ORDER;
+    usz const mesh_dim_y = comm_handler->loc_dim_y + 2 * STENCIL_ORDER;
+    usz const mesh_dim_z = comm_handler->loc_dim_z + 2 * STENCIL_ORDER;
+    usz const len = mesh_dim_x * mesh_dim_y * mesh_dim_z;
+    usz const file_len = COEF_CACHE_DATA_OFFSET + sizeof(f64) * len;
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || (usz)st.st_size != file_len) {
+        warn("ignoring coefficient cache entry `%s`: unexpected size", path);
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, file_len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapping) {
+        warn("failed to map coefficient cache entry `%s`", path);
+        return false;
+    }
+    // Only the header and the samples are read here, the rest of B is faulted in by the first
+    // iteration. Read-ahead is just started for the pages not yet in the page cache.
+    madvise(mapping, file_len, MADV_WILLNEED);
+
+    coef_cache_header_t const* stored = mapping;
+    coef_cache_header_t expected = coef_cache_header(cfg, comm_handler, mesh_dim_x, mesh_dim_y, mesh_dim_z);
+    expected.checksum = stored->checksum;
+    expected.sample_checksum = stored->sample_checksum;
+    expected.header_checksum = stored->header_checksum;
+    f64 const* value = (f64 const*)((char const*)mapping + COEF_CACHE_DATA_OFFSET);
+    if (0 != memcmp(stored, &expected, sizeof(expected)) ||
+        coef_cache_header_checksum(*stored) != stored->header_checksum) {
+        warn("ignoring coefficient cache entry `%s`: key mismatch", path);
+        munmap(mapping, file_len);
+        return false;
+    }
+    if (coef_cache_sample_checksum(value, len) != stored->sample_checksum ||
+        (cfg->coef_cache_verify && coef_cache_checksum(value, len) != stored->checksum)) {
+        warn("ignoring coefficient cache entry `%s`: checksum mismatch", path);
+        munmap(mapping, file_len);
+        return false;
+    }
+
+    *mesh = (mesh_t){
+        .dim_x = mesh_dim_x,
+        .dim_y = mesh_dim_y,
+        .dim_z = mesh_dim_z,
+        .value = (f64*)value,
+        .kind_cell = NULL,
+        .kind = MESH_KIND_CONSTANT,
+        .layout = MESH_LAYOUT_ROW_MAJOR,
+        .mapping = mapping,
+        .mapping_len = file_len,
+    };
+    return true;
+}
+
+void coef_cache_store(
+    char const* dir, config_t const* cfg, comm_handler_t const* comm_handler, mesh_t const* mesh
+) {
+    assert(MESH_LAYOUT_ROW_MAJOR == mesh->layout);
+
+    char path[MAX_PATH_LEN];
+    coef_cache_path(path, dir, cfg, comm_handler);
+    char tmp_path[MAX_PATH_LEN + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (i32)getpid());
+
+    usz const len = mesh->dim_x * mesh->dim_y * mesh->dim_z;
+    coef_cache_header_t header = coef_cache_header(cfg, comm_handler, mesh->dim_x, mesh->dim_y, mesh->dim_z);
+    header.checksum = coef_cache_checksum(mesh->value, len);
+    header.sample_checksum = coef_cache_sample_checksum(mesh->value, len);
+    header.header_checksum = coef_cache_header_checksum(header);
+    static char const padding[COEF_CACHE_DATA_OFFSET] = { 0 };
+
+    mkdir(dir, 0755);
+    FILE* fp = fopen(tmp_path, "wb");
+    if (NULL == fp) {
+        warn("failed to create coefficient cache entry `%s`", tmp_path);
+        return;
+    }
+    bool ok = 1 == fwrite(&header, sizeof(header), 1, fp) &&
+              1 == fwrite(padding, COEF_CACHE_DATA_OFFSET - sizeof(header), 1, fp) &&
+              len == fwrite(mesh->value, sizeof(f64), len, fp);
+    ok = (0 == fclose(fp)) && ok;
+
+    // Readers only ever see complete entries
+    if (!ok || 0 != rename(tmp_path, path)) {
+        warn("failed to write coefficient cache entry `%s`", path);
+        unlink(tmp_path);
+    }
+}
@@ -1,8 +1,10 @@
 #include "stencil/comm_handler.h"
 
 #include "logging.h"
+#include "stencil/trace.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 
@@ -26,7 +28,7 @@ static char *stringify(char buf[static MAXLEN], i32 num)
     return buf;
 }
 
-comm_handler_t comm_handler_new(u32 rank, u32 comm_size, usz dim_x, usz dim_y, usz dim_z)
+comm_handler_t comm_handler_new(MPI_Comm comm, u32 rank, u32 comm_size, usz dim_x, usz dim_y, usz dim_z)
 {
     // Compute splitting
     u32 const nb_z = gcd(comm_size, (u32)(dim_x * dim_y));
@@ -65,6 +67,7 @@ comm_handler_t comm_handler_new(u32 rank, u32 comm_size, usz dim_x, usz dim_y, u
     i32 const id_back = (rank_z < nb_z - 1) ? (i32)(rank + (comm_size / nb_z)) : -1;
 
     return (comm_handler_t){
+        .comm = comm,
         .nb_x = nb_x,
         .nb_y = nb_y,
         .nb_z = nb_z,
@@ -86,7 +89,7 @@ comm_handler_t comm_handler_new(u32 rank, u32 comm_size, usz dim_x, usz dim_y, u
 void comm_handler_print(comm_handler_t const *self)
 {
     i32 rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(self->comm, &rank);
     static char bt[MAXLEN];
     static char bb[MAXLEN];
     static char bl[MAXLEN];
@@ -123,6 +126,30 @@ static i32 MPI_Syncall_callback(MPI_Comm comm)
 }
 static MPI_Syncfunc_t *MPI_Syncall = MPI_Syncall_callback;
 
+/// Returns the trace event name of a message exchanged with the neighbour `target`.
+static char const *exchange_event(comm_handler_t const *self, comm_kind_t comm_kind, i32 target)
+{
+    static char const *const NAMES[2][6] = {
+        {"send left", "send right", "send top", "send bottom", "send front", "send back"},
+        {"recv left", "recv right", "recv top", "recv bottom", "recv front", "recv back"},
+    };
+    i32 const ids[6] = {self->id_left, self->id_right, self->id_top, self->id_bottom, self->id_front, self->id_back};
+    usz d = 0;
+    while (d < 5 && ids[d] != target)
+    {
+        ++d;
+    }
+    return NAMES[comm_kind][d];
+}
+
+/// Barrier separating two phases of an exchange.
+static void exchange_barrier(comm_handler_t const *self)
+{
+    u64 const begin = trace_begin();
+    MPI_Barrier(self->comm);
+    trace_end("barrier", "barrier", NULL, 0, begin);
+}
+
 static void ghost_exchange_left_right(
     comm_handler_t const *self, mesh_t *mesh, comm_kind_t comm_kind, i32 target, usz x_start)
 {
@@ -130,6 +157,7 @@ static void ghost_exchange_left_right(
     {
         return;
     }
+    u64 const begin = trace_begin();
     usz size_buffer =  mesh->dim_y * mesh->dim_z;
     f64(*restrict span_value)[mesh->dim_y][mesh->dim_z] = (f64(*)[mesh->dim_y][mesh->dim_z])mesh->value;
 
@@ -138,15 +166,16 @@ static void ghost_exchange_left_right(
         switch (comm_kind)
         {
         case COMM_KIND_SEND_OP:
-            MPI_Send(&span_value[i + x_start][0][0], size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD);
+            MPI_Send(&span_value[i + x_start][0][0], size_buffer, MPI_DOUBLE, target, 0, self->comm);
             break;
         case COMM_KIND_RECV_OP:
-            MPI_Recv(&span_value[i + x_start][0][0], size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(&span_value[i + x_start][0][0], size_buffer, MPI_DOUBLE, target, 0, self->comm, MPI_STATUS_IGNORE);
             break;
         default:
             __builtin_unreachable();
         }
     }
+    trace_end("exchange", exchange_event(self, comm_kind, target), "peer", target, begin);
 }
 
 static void ghost_exchange_top_bottom(
@@ -156,6 +185,7 @@ static void ghost_exchange_top_bottom(
     {
         return;
     }
+    u64 const begin = trace_begin();
     f64(*restrict span_value)[mesh->dim_y][mesh->dim_z] = (f64(*)[mesh->dim_y][mesh->dim_z])mesh->value;
     usz size_buffer =  mesh->dim_z * STENCIL_ORDER;
 
@@ -164,15 +194,16 @@ static void ghost_exchange_top_bottom(
         switch (comm_kind)
         {
         case COMM_KIND_SEND_OP:
-            MPI_Send(&span_value[i][y_start][0], size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD);
+            MPI_Send(&span_value[i][y_start][0], size_buffer, MPI_DOUBLE, target, 0, self->comm);
             break;
         case COMM_KIND_RECV_OP:
-            MPI_Recv(&span_value[i][y_start][0], size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(&span_value[i][y_start][0], size_buffer, MPI_DOUBLE, target, 0, self->comm, MPI_STATUS_IGNORE);
             break;
         default:
             __builtin_unreachable();
         }
     }
+    trace_end("exchange", exchange_event(self, comm_kind, target), "peer", target, begin);
 }
 
 static void ghost_exchange_front_back(
@@ -182,6 +213,7 @@ static void ghost_exchange_front_back(
     {
         return;
     }
+    u64 const begin = trace_begin();
 
     f64(*restrict span_value)[mesh->dim_y][mesh->dim_z] = (f64(*)[mesh->dim_y][mesh->dim_z])mesh->value;
     usz size_buffer =  mesh->dim_y * STENCIL_ORDER;
@@ -196,7 +228,7 @@ static void ghost_exchange_front_back(
             {
                 memcpy(buffer[j], &span_value[i][j][z_start], sizeof(f64) * STENCIL_ORDER );
             }
-            MPI_Send(&buffer, size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD);
+            MPI_Send(&buffer, size_buffer, MPI_DOUBLE, target, 0, self->comm);
         }
         break;
 
@@ -204,7 +236,7 @@ static void ghost_exchange_front_back(
 
         for (usz i = 0; i < mesh->dim_x; ++i)
         {
-            MPI_Recv(&buffer[0][0], size_buffer, MPI_DOUBLE, target, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(&buffer[0][0], size_buffer, MPI_DOUBLE, target, 0, self->comm, MPI_STATUS_IGNORE);
             for (usz j = 0; j < mesh->dim_y; ++j)
             {
                 memcpy(&span_value[i][j][z_start], buffer[j],sizeof(f64) * STENCIL_ORDER );
@@ -215,10 +247,96 @@ static void ghost_exchange_front_back(
     default:
         __builtin_unreachable();
     }
+    trace_end("exchange", exchange_event(self, comm_kind, target), "peer", target, begin);
+}
+
+/// Exchanges the `depth`-thick slab starting at `start` on `axis` (0 for X, 1 for Y, 2 for Z)
+/// as a single packed message, whatever the layout of the mesh.
+static void ghost_exchange_packed(
+    comm_handler_t const *self, mesh_t *mesh, comm_kind_t comm_kind, i32 target, u32 axis, usz start,
+    usz depth)
+{
+    if (target < 0)
+    {
+        return;
+    }
+    u64 const begin = trace_begin();
+
+    usz lo[3] = {0, 0, 0};
+    usz hi[3] = {mesh->dim_x, mesh->dim_y, mesh->dim_z};
+    lo[axis] = start;
+    hi[axis] = start + depth;
+    usz const size_buffer = (hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]);
+    f64 *buffer = malloc(sizeof(f64) * size_buffer);
+    if (NULL == buffer)
+    {
+        error("failed to allocate %zu bytes for ghost exchange buffer", sizeof(f64) * size_buffer);
+    }
+
+    switch (comm_kind)
+    {
+    case COMM_KIND_SEND_OP:
+        mesh_pack(mesh, buffer, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+        MPI_Send(buffer, size_buffer, MPI_DOUBLE, target, 0, self->comm);
+        break;
+    case COMM_KIND_RECV_OP:
+        MPI_Recv(buffer, size_buffer, MPI_DOUBLE, target, 0, self->comm, MPI_STATUS_IGNORE);
+        mesh_unpack(mesh, buffer, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+    trace_end("exchange", exchange_event(self, comm_kind, target), "peer", target, begin);
+
+    free(buffer);
+}
+
+/// Ghost cell exchange of the `depth` layers closest to the core, each face packed into one
+/// contiguous message. Used for meshes that are not stored in layout right, and for narrow halos.
+static void ghost_exchange_phased(comm_handler_t const *self, mesh_t *mesh, usz depth)
+{
+    usz const ghost = STENCIL_ORDER - depth;
+
+    // Left to right, then right to left phase
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_right, 0, mesh->dim_x - STENCIL_ORDER - depth, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_left, 0, ghost, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_left, 0, STENCIL_ORDER, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_right, 0, mesh->dim_x - STENCIL_ORDER, depth);
+    exchange_barrier(self);
+
+    // Top to bottom, then bottom to top phase
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_top, 1, mesh->dim_y - STENCIL_ORDER - depth, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_bottom, 1, ghost, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_bottom, 1, STENCIL_ORDER, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_top, 1, mesh->dim_y - STENCIL_ORDER, depth);
+    exchange_barrier(self);
+
+    // Front to back, then back to front phase
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_back, 2, mesh->dim_z - STENCIL_ORDER - depth, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_front, 2, ghost, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_SEND_OP, self->id_front, 2, STENCIL_ORDER, depth);
+    ghost_exchange_packed(self, mesh, COMM_KIND_RECV_OP, self->id_back, 2, mesh->dim_z - STENCIL_ORDER, depth);
+    exchange_barrier(self);
+}
+
+void comm_handler_ghost_exchange_depth(comm_handler_t const *self, mesh_t *mesh, usz depth)
+{
+    if (STENCIL_ORDER == depth)
+    {
+        comm_handler_ghost_exchange(self, mesh);
+        return;
+    }
+    ghost_exchange_phased(self, mesh, depth);
 }
 
 void comm_handler_ghost_exchange(comm_handler_t const *self, mesh_t *mesh)
 {
+    if (MESH_LAYOUT_ROW_MAJOR != mesh->layout)
+    {
+        ghost_exchange_phased(self, mesh, STENCIL_ORDER);
+        return;
+    }
+
     // Left to right phase
     ghost_exchange_left_right(self, mesh, COMM_KIND_SEND_OP, self->id_right, mesh->dim_x - 2 * STENCIL_ORDER);
     ghost_exchange_left_right(self, mesh, COMM_KIND_RECV_OP, self->id_left, 0);
@@ -226,7 +344,7 @@ void comm_handler_ghost_exchange(comm_handler_t const *self, mesh_t *mesh)
     ghost_exchange_left_right(self, mesh, COMM_KIND_SEND_OP, self->id_left, STENCIL_ORDER);
     ghost_exchange_left_right(self, mesh, COMM_KIND_RECV_OP, self->id_right, mesh->dim_x - STENCIL_ORDER);
     // Prevent mixing communication from left/right with top/bottom and front/back
-    MPI_Barrier(MPI_COMM_WORLD);
+    exchange_barrier(self);
 
     // Top to bottom phase
     ghost_exchange_top_bottom(self, mesh, COMM_KIND_SEND_OP, self->id_top, mesh->dim_y - 2 * STENCIL_ORDER);
@@ -235,7 +353,7 @@ void comm_handler_ghost_exchange(comm_handler_t const *self, mesh_t *mesh)
     ghost_exchange_top_bottom(self, mesh, COMM_KIND_SEND_OP, self->id_bottom, STENCIL_ORDER);
     ghost_exchange_top_bottom(self, mesh, COMM_KIND_RECV_OP, self->id_top, mesh->dim_y - STENCIL_ORDER);
     // Prevent mixing communication from top/bottom with left/right and front/back
-    MPI_Barrier(MPI_COMM_WORLD);
+    exchange_barrier(self);
 
     // Front to back phase
     ghost_exchange_front_back(self, mesh, COMM_KIND_SEND_OP, self->id_back, mesh->dim_z - 2 * STENCIL_ORDER);
@@ -246,5 +364,5 @@ void comm_handler_ghost_exchange(comm_handler_t const *self, mesh_t *mesh)
 
     // Need to synchronize all remaining in-flight communications before exiting
     // MPI_Syncall(MPI_COMM_WORLD);
-    MPI_Barrier(MPI_COMM_WORLD);
+    exchange_barrier(self);
 }
@@ -0,0 +1,64 @@
+#include "stencil/comm_handler.h"
+
+#include "logging.h"
+
+#include <stdio.h>
+
+/// Shared-memory-only backend (`STENCIL_USE_MPI=OFF`): the only rank owns the whole mesh and
+/// every face of it is a physical boundary, so there are no ghost cells to exchange.
+
+comm_handler_t comm_handler_new(MPI_Comm comm, u32 rank, u32 comm_size, usz dim_x, usz dim_y, usz dim_z)
+{
+    if (1 != comm_size || 0 != rank)
+    {
+        error("built without MPI, expected a single rank, got %u", comm_size);
+    }
+
+    return (comm_handler_t){
+        .comm = comm,
+        .nb_x = 1,
+        .nb_y = 1,
+        .nb_z = 1,
+        .coord_x = 0,
+        .coord_y = 0,
+        .coord_z = 0,
+        .loc_dim_x = dim_x,
+        .loc_dim_y = dim_y,
+        .loc_dim_z = dim_z,
+        .id_left = -1,
+        .id_right = -1,
+        .id_top = -1,
+        .id_bottom = -1,
+        .id_back = -1,
+        .id_front = -1,
+    };
+}
+
+void comm_handler_print(comm_handler_t const *self)
+{
+    fprintf(
+        stderr,
+        "****************************************\n"
+        "RANK 0 (no MPI):\n"
+        "  COORDS:     %u,%u,%u\n"
+        "  LOCAL DIMS: %zu,%zu,%zu\n",
+        self->coord_x,
+        self->coord_y,
+        self->coord_z,
+        self->loc_dim_x,
+        self->loc_dim_y,
+        self->loc_dim_z);
+}
+
+void comm_handler_ghost_exchange(comm_handler_t const *self, mesh_t *mesh)
+{
+    (void)self;
+    (void)mesh;
+}
+
+void comm_handler_ghost_exchange_depth(comm_handler_t const *self, mesh_t *mesh, usz depth)
+{
+    (void)self;
+    (void)mesh;
+    (void)depth;
+}
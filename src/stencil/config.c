@@ -13,6 +13,25 @@ static inline config_t config_default() {
         .dim_y = 100,
         .dim_z = 100,
         .niter = 5,
+        .kernel = SOLVER_KIND_BLOCKED,
+        .exec = EXEC_MODE_BULK,
+        .approx = 0.0,
+        .approx_check = false,
+        .subdomains = 1,
+        .layout = MESH_LAYOUT_ROW_MAJOR,
+        .counters = false,
+        .affinity = false,
+        .reorder = false,
+        .node_size = 0,
+        .coef_cache_dir = "",
+        .coef_cache_verify = false,
+        .receivers_file = "",
+        .seismogram_file = "seismogram.txt",
+        .seismogram_chunk = 64,
+        .trace_file = "",
+        .trace_events = 1 << 16,
+        .diag = 0,
+        .diag_abort = 0.0,
     };
 }
 
@@ -27,33 +46,85 @@ config_t config_parse_from_file(char const file_name[static 1]) {
     usz MAX_LINE_LEN = 64;
     char* line_buf = malloc(MAX_LINE_LEN);
     usz line_num = 0;
-    while (0 == feof(cfp)) {
+    while (-1 != getline(&line_buf, &MAX_LINE_LEN, cfp)) {
         line_num += 1;
-        getline(&line_buf, &MAX_LINE_LEN, cfp);
-        if (NULL == line_buf) {
-            warn("failed to read line %zu in file %s, using default", line_num, file_name);
-            return config_default();
-        }
 
-        if ('#' == line_buf[0]) {
+        if ('#' == line_buf[0] || '\n' == line_buf[0]) {
             continue;
         }
 
-        usz const MAX_TOKEN_LEN = 5;
-        char key[MAX_TOKEN_LEN + 5];
-        usz val;
-        sscanf(line_buf, "%5s=%zu\n", key, &val);
+        char key[32];
+        char val[256];
+        if (2 != sscanf(line_buf, "%31[^=]=%255s", key, val)) {
+            warn("malformed line %zu in file %s, using default", line_num, file_name);
+            free(line_buf);
+            fclose(cfp);
+            return config_default();
+        }
 
         if (strcmp("dim_x", key) == 0) {
-            self.dim_x = val;
+            self.dim_x = strtoul(val, NULL, 10);
         } else if (strcmp("dim_y", key) == 0) {
-            self.dim_y = val;
+            self.dim_y = strtoul(val, NULL, 10);
         } else if (strcmp("dim_z", key) == 0) {
-            self.dim_z = val;
+            self.dim_z = strtoul(val, NULL, 10);
         } else if (strcmp("niter", key) == 0) {
-            self.niter = val;
+            self.niter = strtoul(val, NULL, 10);
+        } else if (strcmp("kernel", key) == 0) {
+            if (!solver_kind_from_str(val, &self.kernel)) {
+                warn("unknown kernel `%s` at line %zu, using `%s`", val, line_num,
+                     solver_kind_as_str(self.kernel));
+            }
+        } else if (strcmp("exec", key) == 0) {
+            if (!exec_mode_from_str(val, &self.exec)) {
+                warn("unknown execution mode `%s` at line %zu, using `%s`", val, line_num,
+                     exec_mode_as_str(self.exec));
+            }
+        } else if (strcmp("approx", key) == 0) {
+            self.approx = strtod(val, NULL);
+        } else if (strcmp("approx_check", key) == 0) {
+            self.approx_check = 0 != strtoul(val, NULL, 10);
+        } else if (strcmp("subdomains", key) == 0) {
+            self.subdomains = strtoul(val, NULL, 10);
+        } else if (strcmp("layout", key) == 0) {
+            if (strcmp("row_major", val) == 0) {
+                self.layout = MESH_LAYOUT_ROW_MAJOR;
+            } else if (strcmp("bricked", val) == 0) {
+                self.layout = MESH_LAYOUT_BRICKED;
+            } else {
+                warn("unknown layout `%s` at line %zu, using `%s`", val, line_num,
+                     mesh_layout_as_str(self.layout));
+            }
+        } else if (strcmp("counters", key) == 0) {
+            self.counters = 0 != strtoul(val, NULL, 10);
+        } else if (strcmp("affinity", key) == 0) {
+            self.affinity = 0 != strtoul(val, NULL, 10);
+        } else if (strcmp("reorder", key) == 0) {
+            self.reorder = 0 != strtoul(val, NULL, 10);
+        } else if (strcmp("node_size", key) == 0) {
+            self.node_size = strtoul(val, NULL, 10);
+        } else if (strcmp("coef_cache", key) == 0) {
+            snprintf(self.coef_cache_dir, sizeof(self.coef_cache_dir), "%s", val);
+        } else if (strcmp("coef_cache_verify", key) == 0) {
+            self.coef_cache_verify = 0 != strtoul(val, NULL, 10);
+        } else if (strcmp("receivers", key) == 0) {
+            snprintf(self.receivers_file, sizeof(self.receivers_file), "%s", val);
+        } else if (strcmp("seismogram", key) == 0) {
+            snprintf(self.seismogram_file, sizeof(self.seismogram_file), "%s", val);
+        } else if (strcmp("seismogram_chunk", key) == 0) {
+            self.seismogram_chunk = strtoul(val, NULL, 10);
+        } else if (strcmp("trace", key) == 0) {
+            snprintf(self.trace_file, sizeof(self.trace_file), "%s", val);
+        } else if (strcmp("trace_events", key) == 0) {
+            self.trace_events = strtoul(val, NULL, 10);
+        } else if (strcmp("diag", key) == 0) {
+            self.diag = strtoul(val, NULL, 10);
+        } else if (strcmp("diag_abort", key) == 0) {
+            self.diag_abort = strtod(val, NULL);
         } else {
             warn("unknown key `%s` at line %zu", key, line_num);
+            free(line_buf);
+            fclose(cfp);
             return config_default();
         }
     }
@@ -87,10 +158,45 @@ void config_print(config_t const* self) {
         "X-axis dimension ................... %zu\n"
         "Y-axis dimension ................... %zu\n"
         "Z-axis dimension ................... %zu\n"
-        "Number of iterations ............... %zu\n",
+        "Number of iterations ............... %zu\n"
+        "Kernel ............................. %s\n"
+        "Execution .......................... %s\n"
+        "Approximation tolerance ............ %.3le%s\n"
+        "Sub-domains per rank ............... %zu\n"
+        "Mesh layout ........................ %s\n"
+        "Hardware counters .................. %s\n"
+        "Thread pinning ..................... %s\n"
+        "Node-aware rank reordering ......... %s%s\n"
+        "Coefficient cache .................. %s%s\n"
+        "Receivers .......................... %s\n"
+        "Seismogram ......................... %s (every %zu steps)\n"
+        "Timeline trace ..................... %s (%zu events per thread)\n"
+        "Diagnostics reduction period ....... %zu%s\n"
+        "Divergence threshold ............... %.3le%s\n",
         self->dim_x,
         self->dim_y,
         self->dim_z,
-        self->niter
+        self->niter,
+        solver_kind_as_str(self->kernel),
+        exec_mode_as_str(self->exec),
+        self->approx,
+        self->approx > 0.0 ? (self->approx_check ? " (checked)" : "") : " (off)",
+        self->subdomains,
+        mesh_layout_as_str(self->layout),
+        self->counters ? "on" : "off",
+        self->affinity ? "on" : "off",
+        self->reorder ? "on" : "off",
+        self->reorder && 0 == self->node_size ? " (nodes detected)" : "",
+        '\0' != self->coef_cache_dir[0] ? self->coef_cache_dir : "off",
+        '\0' != self->coef_cache_dir[0] && self->coef_cache_verify ? " (verified)" : "",
+        '\0' != self->receivers_file[0] ? self->receivers_file : "off",
+        self->seismogram_file,
+        self->seismogram_chunk,
+        '\0' != self->trace_file[0] ? self->trace_file : "off",
+        self->trace_events,
+        self->diag,
+        self->diag > 0 ? " steps" : " (off)",
+        self->diag_abort,
+        self->diag_abort > 0.0 ? "" : " (off)"
     );
 }
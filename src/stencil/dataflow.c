@@ -0,0 +1,420 @@
+#include "stencil/dataflow.h"
+
+#include "logging.h"
+#include "stencil/solve.h"
+#include "stencil/trace.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Tile edge lengths on the X, Y and Z axes. They must be at least `STENCIL_ORDER` so that a
+/// tile only reads its face neighbours; the last tile of an axis absorbs the remainder.
+static usz const TILE_DIM[3] = { 16, 16, 64 };
+
+/// Number of halo links: one per direction a face travels in.
+#define NB_LINKS 6
+
+/// Trace event names of the face sent and received on each link of `dataflow_run`.
+static char const* const LINK_SEND_EVENT[NB_LINKS] = {
+    "send right", "send left", "send top", "send bottom", "send back", "send front",
+};
+static char const* const LINK_RECV_EVENT[NB_LINKS] = {
+    "recv left", "recv right", "recv bottom", "recv top", "recv front", "recv back",
+};
+
+static char const* EXEC_MODES_STR[] = {
+    "bulk",
+    "tasks",
+};
+
+char const* exec_mode_as_str(exec_mode_t mode) {
+    return EXEC_MODES_STR[(usz)mode];
+}
+
+bool exec_mode_from_str(char const* str, exec_mode_t* mode) {
+    for (usz i = 0; i < countof(EXEC_MODES_STR); ++i) {
+        if (strcmp(EXEC_MODES_STR[i], str) == 0) {
+            *mode = (exec_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool dataflow_supported(mesh_t const* A) {
+    if (MESH_LAYOUT_ROW_MAJOR != A->layout) {
+        warn("task mode requires the `%s` layout", mesh_layout_as_str(MESH_LAYOUT_ROW_MAJOR));
+        return false;
+    }
+    i32 provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        warn("task mode requires %s support from the MPI library", "MPI_THREAD_SERIALIZED");
+        return false;
+    }
+    return true;
+}
+
+/// A face sent to `target` and the matching face received from `source` on the same axis.
+/// With `high`, the last core slab is sent and the low ghost slab is received, the other way
+/// around otherwise. Mirrors the phases of `comm_handler_ghost_exchange`.
+typedef struct halo_link_s {
+    u32 axis;
+    bool high;
+    i32 target;
+    i32 source;
+} halo_link_t;
+
+/// Number of tiles covering `core` points.
+static usz tile_count(usz core, usz size) {
+    return core >= size ? core / size : 1;
+}
+
+/// Ghost-inclusive bounds of tile `t` out of `n` on an axis of `core` points.
+static void tile_bounds(usz t, usz n, usz size, usz core, usz* lo, usz* hi) {
+    *lo = STENCIL_ORDER + t * size;
+    *hi = (t == n - 1) ? STENCIL_ORDER + core : *lo + size;
+}
+
+/// Tile holding the ghost-inclusive coordinate `c`.
+static usz tile_of(usz c, usz n, usz size) {
+    usz const t = (c - STENCIL_ORDER) / size;
+    return t < n ? t : n - 1;
+}
+
+/// Ghost-inclusive box of the face sent (`recv == false`) or received on a link.
+static void link_box(halo_link_t const* link, mesh_t const* mesh, bool recv, usz lo[3], usz hi[3]) {
+    usz const dim[3] = { mesh->dim_x, mesh->dim_y, mesh->dim_z };
+    for (u32 a = 0; a < 3; ++a) {
+        lo[a] = STENCIL_ORDER;
+        hi[a] = dim[a] - STENCIL_ORDER;
+    }
+    usz const a = link->axis;
+    if (recv) {
+        lo[a] = link->high ? 0 : dim[a] - STENCIL_ORDER;
+    } else {
+        lo[a] = link->high ? dim[a] - 2 * STENCIL_ORDER : STENCIL_ORDER;
+    }
+    hi[a] = lo[a] + STENCIL_ORDER;
+}
+
+/// State shared by the producer and the tasks of `dataflow_run`.
+typedef struct dataflow_s {
+    comm_handler_t const* ch;
+    mesh_t* mesh[2];
+    mesh_t const* B;
+    usz core[3];
+    usz nt[3];
+    halo_link_t links[NB_LINKS];
+    /// Message buffers and requests per written buffer and link.
+    usz face_len[NB_LINKS];
+    f64* send_buf[2][NB_LINKS];
+    f64* recv_buf[2][NB_LINKS];
+    MPI_Request send_req[2][NB_LINKS];
+    MPI_Request recv_req[2][NB_LINKS];
+    /// Dependency objects: the core of each tile, the ghost faces and the send buffers of each
+    /// of the two buffers. Only their addresses matter.
+    char* tile_dep;
+    char halo_dep[2][NB_LINKS];
+    char send_dep[2][NB_LINKS];
+    char none;
+} dataflow_t;
+
+#define TILE_DEP(self, p, x, y, z) (self)->tile_dep[((((p) * (self)->nt[0] + (x)) * (self)->nt[1] + (y)) * (self)->nt[2] + (z))]
+
+/// Returns whether tile `t` reads the ghost face received on link `l`.
+static bool tile_reads(dataflow_t const* self, usz const t[3], usz l) {
+    halo_link_t const* link = &self->links[l];
+    return link->source >= 0 && (link->high ? 0 == t[link->axis] : self->nt[link->axis] - 1 == t[link->axis]);
+}
+
+/// Spawns the update of tile `(tx, ty, tz)` from buffer `src` into buffer `dst`.
+static void spawn_tile(dataflow_t* self, usz src, usz dst, usz tx, usz ty, usz tz) {
+    usz const* nt = self->nt;
+    usz const t[3] = { tx, ty, tz };
+    // Face neighbours (clamped to the tile itself on the edges of the mesh)
+    usz const xm = tx > 0 ? tx - 1 : tx, xp = tx + 1 < nt[0] ? tx + 1 : tx;
+    usz const ym = ty > 0 ? ty - 1 : ty, yp = ty + 1 < nt[1] ? ty + 1 : ty;
+    usz const zm = tz > 0 ? tz - 1 : tz, zp = tz + 1 < nt[2] ? tz + 1 : tz;
+    // Received ghost faces read by boundary tiles
+    char* halo[NB_LINKS];
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        halo[l] = tile_reads(self, t, l) ? &self->halo_dep[src][l] : &self->none;
+    }
+
+    #pragma omp task firstprivate(self, src, dst, tx, ty, tz) \
+        depend(in: TILE_DEP(self, src, tx, ty, tz), TILE_DEP(self, src, xm, ty, tz), \
+               TILE_DEP(self, src, xp, ty, tz), TILE_DEP(self, src, tx, ym, tz), \
+               TILE_DEP(self, src, tx, yp, tz), TILE_DEP(self, src, tx, ty, zm), \
+               TILE_DEP(self, src, tx, ty, zp)) \
+        depend(in: *halo[0], *halo[1], *halo[2], *halo[3], *halo[4], *halo[5]) \
+        depend(out: TILE_DEP(self, dst, tx, ty, tz))
+    {
+        usz lo[3], hi[3];
+        tile_bounds(tx, self->nt[0], TILE_DIM[0], self->core[0], &lo[0], &hi[0]);
+        tile_bounds(ty, self->nt[1], TILE_DIM[1], self->core[1], &lo[1], &hi[1]);
+        tile_bounds(tz, self->nt[2], TILE_DIM[2], self->core[2], &lo[2], &hi[2]);
+        u64 const begin = trace_begin();
+        solve_jacobi_box(self->mesh[src], self->B, self->mesh[dst], lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+        trace_end("kernel", "tile", "tile", (i64)((tx * self->nt[1] + ty) * self->nt[2] + tz), begin);
+    }
+}
+
+/// Spawns the tiles from buffer `src` whose ghost faces have all `arrived`. With `l < NB_LINKS`,
+/// only the tiles reading the face of link `l`, which just arrived, are considered.
+static void spawn_ready_tiles(dataflow_t* self, usz src, usz dst, bool const arrived[NB_LINKS], usz l) {
+    for (usz tx = 0; tx < self->nt[0]; ++tx) {
+        for (usz ty = 0; ty < self->nt[1]; ++ty) {
+            for (usz tz = 0; tz < self->nt[2]; ++tz) {
+                usz const t[3] = { tx, ty, tz };
+                bool ready = NB_LINKS == l || tile_reads(self, t, l);
+                for (usz f = 0; f < NB_LINKS && ready; ++f) {
+                    ready = arrived[f] || !tile_reads(self, t, f);
+                }
+                if (ready) {
+                    spawn_tile(self, src, dst, tx, ty, tz);
+                }
+            }
+        }
+    }
+}
+
+/// Posts the receives of the ghost faces of buffer `p`, before any task of the iteration that
+/// writes it so that the faces never wait for a matching receive.
+static void post_receives(dataflow_t* self, usz p) {
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        if (self->links[l].source < 0) {
+            continue;
+        }
+        #pragma omp critical(dataflow_mpi)
+        MPI_Irecv(
+            self->recv_buf[p][l],
+            (i32)self->face_len[l],
+            MPI_DOUBLE,
+            self->links[l].source,
+            (i32)(2 * l + p),
+            self->ch->comm,
+            &self->recv_req[p][l]
+        );
+    }
+}
+
+/// Unpacks the ghost faces of buffer `p` as they arrive, until all have. When `spawn_dst` is a
+/// buffer, the tiles of the next iteration reading a face are spawned as soon as it lands.
+/// Polling is done by the producer alone: no task ever waits on a message.
+static void land_faces(dataflow_t* self, usz p, bool arrived[NB_LINKS], usz spawn_dst) {
+    bool sent = false;
+    for (;;) {
+        bool all = true;
+        for (usz l = 0; l < NB_LINKS; ++l) {
+            all = all && arrived[l];
+        }
+        if (all) {
+            return;
+        }
+
+        i32 outcount;
+        i32 indices[NB_LINKS];
+        #pragma omp critical(dataflow_mpi)
+        MPI_Testsome(NB_LINKS, self->recv_req[p], &outcount, indices, MPI_STATUSES_IGNORE);
+        if (MPI_UNDEFINED == outcount || 0 == outcount) {
+            // Every face spawned by this rank must be on its way before spinning on the
+            // neighbours' ones (with one thread, queued sends only run in this wait)
+            if (!sent) {
+                u64 const begin = trace_begin();
+                #pragma omp taskwait depend(in: self->send_dep[0][0], self->send_dep[0][1], \
+                                            self->send_dep[0][2], self->send_dep[0][3], \
+                                            self->send_dep[0][4], self->send_dep[0][5], \
+                                            self->send_dep[1][0], self->send_dep[1][1], \
+                                            self->send_dep[1][2], self->send_dep[1][3], \
+                                            self->send_dep[1][4], self->send_dep[1][5])
+                trace_end("barrier", "wait sends", NULL, 0, begin);
+                sent = true;
+            }
+            continue;
+        }
+
+        for (i32 i = 0; i < outcount; ++i) {
+            usz const l = (usz)indices[i];
+            // The previous face in these ghost cells may still be read
+            u64 const begin = trace_begin();
+            #pragma omp taskwait depend(inout: self->halo_dep[p][l])
+            usz lo[3], hi[3];
+            link_box(&self->links[l], self->mesh[p], true, lo, hi);
+            mesh_unpack(self->mesh[p], self->recv_buf[p][l], lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            trace_end("exchange", LINK_RECV_EVENT[l], "peer", self->links[l].source, begin);
+            arrived[l] = true;
+            if (spawn_dst < 2) {
+                spawn_ready_tiles(self, p, spawn_dst, arrived, l);
+            }
+        }
+    }
+}
+
+/// Spawns the send of the faces of buffer `dst` once their boundary tiles are done.
+static void spawn_sends(dataflow_t* self, usz dst) {
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        if (self->links[l].target < 0) {
+            continue;
+        }
+
+        // The buffer may still be in flight from two iterations ago. Its send task has
+        // completed once the send dependency is met, then only the producer touches the request.
+        #pragma omp taskwait depend(in: self->send_dep[dst][l])
+        for (i32 done = 0; !done;) {
+            #pragma omp critical(dataflow_mpi)
+            MPI_Test(&self->send_req[dst][l], &done, MPI_STATUS_IGNORE);
+        }
+
+        // Sends only wait for the boundary tiles of their face: `tn` tiles from `tlo` on each
+        // axis. GCC does not count reads in an iterator, so no variable is only read there.
+        usz const a = self->links[l].axis;
+        i32 tlo[3] = { 0, 0, 0 };
+        i32 tn[3] = { (i32)self->nt[0], (i32)self->nt[1], (i32)self->nt[2] };
+        tlo[a] = self->links[l].high ? tn[a] - 1 : 0;
+        tn[a] = 1;
+
+        #pragma omp task firstprivate(self, dst, l) \
+            depend(iterator(i32 i = tlo[0]:tlo[0] + tn[0], i32 j = tlo[1]:tlo[1] + tn[1], \
+                            i32 k = tlo[2]:tlo[2] + tn[2]), \
+                   in: TILE_DEP(self, dst, i, j, k)) \
+            depend(inout: self->send_dep[dst][l])
+        {
+            u64 const begin = trace_begin();
+            usz lo[3], hi[3];
+            link_box(&self->links[l], self->mesh[dst], false, lo, hi);
+            mesh_pack(self->mesh[dst], self->send_buf[dst][l], lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            #pragma omp critical(dataflow_mpi)
+            MPI_Isend(
+                self->send_buf[dst][l],
+                (i32)self->face_len[l],
+                MPI_DOUBLE,
+                self->links[l].target,
+                (i32)(2 * l + dst),
+                self->ch->comm,
+                &self->send_req[dst][l]
+            );
+            trace_end("exchange", LINK_SEND_EVENT[l], "peer", self->links[l].target, begin);
+        }
+    }
+}
+
+void dataflow_run(
+    comm_handler_t const* ch,
+    mesh_t* A,
+    mesh_t const* B,
+    mesh_t* C,
+    usz niter,
+    usz nb_probes,
+    usz const (*probes)[3],
+    f64* values
+) {
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout && MESH_LAYOUT_ROW_MAJOR == C->layout);
+    if (0 == niter) {
+        return;
+    }
+
+    dataflow_t self = {
+        .ch = ch,
+        .mesh = { A, C },
+        .B = B,
+        .core = {
+            A->dim_x - 2 * STENCIL_ORDER,
+            A->dim_y - 2 * STENCIL_ORDER,
+            A->dim_z - 2 * STENCIL_ORDER,
+        },
+        .links = {
+            { 0, true, ch->id_right, ch->id_left },
+            { 0, false, ch->id_left, ch->id_right },
+            { 1, true, ch->id_top, ch->id_bottom },
+            { 1, false, ch->id_bottom, ch->id_top },
+            { 2, true, ch->id_back, ch->id_front },
+            { 2, false, ch->id_front, ch->id_back },
+        },
+    };
+    for (u32 a = 0; a < 3; ++a) {
+        self.nt[a] = tile_count(self.core[a], TILE_DIM[a]);
+    }
+
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        halo_link_t const* link = &self.links[l];
+        usz lo[3], hi[3];
+        link_box(link, A, false, lo, hi);
+        self.face_len[l] = (hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]);
+        for (usz p = 0; p < 2; ++p) {
+            self.send_buf[p][l] = link->target >= 0 ? malloc(sizeof(f64) * self.face_len[l]) : NULL;
+            self.recv_buf[p][l] = link->source >= 0 ? malloc(sizeof(f64) * self.face_len[l]) : NULL;
+            self.send_req[p][l] = MPI_REQUEST_NULL;
+            self.recv_req[p][l] = MPI_REQUEST_NULL;
+        }
+
+        // Faces without a neighbour are never exchanged: both buffers must hold the same
+        // boundary values, as in bulk mode where C is only ever copied into A's core
+        if (link->source < 0) {
+            link_box(link, A, true, lo, hi);
+            f64* face = malloc(sizeof(f64) * self.face_len[l]);
+            mesh_pack(A, face, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            mesh_unpack(C, face, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            free(face);
+        }
+    }
+    self.tile_dep = calloc(2 * self.nt[0] * self.nt[1] * self.nt[2], sizeof(char));
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        for (usz it = 0; it < niter; ++it) {
+            usz const src = it % 2;
+            usz const dst = 1 - src;
+
+            // Faces computed during this iteration are read by the next one
+            post_receives(&self, dst);
+
+            // Interior tiles start right away, boundary tiles once the faces of the previous
+            // iteration they read have landed (the first iteration reads the initial ghost cells)
+            bool arrived[NB_LINKS];
+            for (usz l = 0; l < NB_LINKS; ++l) {
+                arrived[l] = 0 == it || self.links[l].source < 0;
+            }
+            spawn_ready_tiles(&self, src, dst, arrived, NB_LINKS);
+            land_faces(&self, src, arrived, dst);
+
+            spawn_sends(&self, dst);
+
+            for (usz p = 0; p < nb_probes; ++p) {
+                usz const* pt = probes[p];
+                usz const tx = tile_of(pt[0], self.nt[0], TILE_DIM[0]);
+                usz const ty = tile_of(pt[1], self.nt[1], TILE_DIM[1]);
+                usz const tz = tile_of(pt[2], self.nt[2], TILE_DIM[2]);
+
+                #pragma omp task firstprivate(dst, it, p, pt) depend(in: TILE_DEP(&self, dst, tx, ty, tz))
+                values[it * nb_probes + p] = idx_const(self.mesh[dst], pt[0], pt[1], pt[2]);
+            }
+        }
+
+        // Faces of the last iteration are the ghost cells of the next run
+        bool arrived[NB_LINKS];
+        for (usz l = 0; l < NB_LINKS; ++l) {
+            arrived[l] = self.links[l].source < 0;
+        }
+        land_faces(&self, niter % 2, arrived, 2);
+    }
+#undef TILE_DEP
+
+    for (usz p = 0; p < 2; ++p) {
+        MPI_Waitall(NB_LINKS, self.send_req[p], MPI_STATUSES_IGNORE);
+        for (usz l = 0; l < NB_LINKS; ++l) {
+            free(self.send_buf[p][l]);
+            free(self.recv_buf[p][l]);
+        }
+    }
+    free(self.tile_dep);
+
+    // The last iteration wrote into C
+    if (1 == niter % 2) {
+        f64* value = A->value;
+        A->value = C->value;
+        C->value = value;
+    }
+}
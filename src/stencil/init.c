@@ -1,19 +1,22 @@
 #include "stencil/init.h"
 
+#include "logging.h"
 #include "stencil/comm_handler.h"
 #include "stencil/mesh.h"
 
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 static inline f64 compute_core_pressure(f64 i, f64 j, f64 k) {
     return sin((f64)k * cos((f64)i + 0.311) * cos((f64)j + 0.817) + 0.613);
 }
 
+/// Fills the values of a mesh in its current layout. Ghost cells left at zero are either filled
+/// by the ghost exchange or lie on the boundary of the domain.
 static void setup_mesh_cell_values(mesh_t* mesh, comm_handler_t const* comm_handler) {
-
-    f64(*restrict span_value)[mesh->dim_y][mesh->dim_z] = (f64(*)[mesh->dim_y][mesh->dim_z])mesh->value;
+    f64* value = mesh->value;
 
     usz const dim_x = mesh->dim_x;
     usz const dim_y = mesh->dim_y;
@@ -25,31 +28,20 @@ static void setup_mesh_cell_values(mesh_t* mesh, comm_handler_t const* comm_hand
             for (usz i = 0; i < dim_x; ++i) 
                 for (usz j = 0; j < dim_y; ++j) 
                     for (usz k = 0; k < dim_z; ++k) 
-                        span_value[i][j][k] =  sin((f64)k * cos((f64)i + 0.311) * cos((f64)j + 0.817) + 0.613);
+                        value[mesh_offset(mesh, i, j, k)] = compute_core_pressure((f64)i, (f64)j, (f64)k);
             break;
         
 
         case MESH_KIND_INPUT:
+            memset(value, 0, mesh_len(mesh) * sizeof(f64));
             for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i) 
                 for (usz j = STENCIL_ORDER; j < dim_y - STENCIL_ORDER; ++j) 
                     for (usz k = STENCIL_ORDER; k < dim_z - STENCIL_ORDER; ++k) 
-                        span_value[i][j][k] = 1.0;
-            
-            for (usz i = 0; i < STENCIL_ORDER; ++i) 
-                for (usz j = 0; j < STENCIL_ORDER; ++j) 
-                    for (usz k = 0; k < STENCIL_ORDER; ++k) 
-                        span_value[i][j][k] = 0.0;
-
-            for (usz i = dim_x - STENCIL_ORDER; i < dim_x; ++i) 
-                for (usz j = dim_y - STENCIL_ORDER; j < dim_y; ++j) 
-                    for (usz k = dim_z - STENCIL_ORDER; k < dim_z; ++k) 
-                        span_value[i][j][k] = 0.0;
-
+                        value[mesh_offset(mesh, i, j, k)] = 1.0;
             break;
 
         case MESH_KIND_OUTPUT:
-            memset(span_value,0.0,dim_x*dim_y*dim_z*sizeof(f64));
-
+            memset(value, 0, mesh_len(mesh) * sizeof(f64));
             break;
 
         default:
@@ -60,7 +52,7 @@ static void setup_mesh_cell_values(mesh_t* mesh, comm_handler_t const* comm_hand
 
 static void setup_mesh_cell_kinds(mesh_t* mesh) {
 
-    cell_kind_t(*restrict span_kind)[mesh->dim_y][mesh->dim_z] = (cell_kind_t(*)[mesh->dim_y][mesh->dim_z])mesh->value;
+    cell_kind_t(*restrict span_kind)[mesh->dim_y][mesh->dim_z] = (cell_kind_t(*)[mesh->dim_y][mesh->dim_z])mesh->kind_cell;
 
 
     for (usz i = STENCIL_ORDER; i < mesh->dim_x - STENCIL_ORDER; ++i) 
@@ -82,25 +74,100 @@ static void setup_mesh_cell_kinds(mesh_t* mesh) {
 
 }
 
+void init_mesh(mesh_t* mesh, comm_handler_t const* comm_handler) {
+    assert(mesh->dim_x == comm_handler->loc_dim_x + STENCIL_ORDER * 2);
+    assert(mesh->dim_y == comm_handler->loc_dim_y + STENCIL_ORDER * 2);
+    assert(mesh->dim_z == comm_handler->loc_dim_z + STENCIL_ORDER * 2);
+
+    if (NULL != mesh->kind_cell) {
+        setup_mesh_cell_kinds(mesh);
+    }
+    setup_mesh_cell_values(mesh, comm_handler);
+}
+
 void init_meshes(mesh_t* A, mesh_t* B, mesh_t* C, comm_handler_t const* comm_handler) {
-    assert(
-        A->dim_x == B->dim_x && B->dim_x == C->dim_x &&
-        C->dim_x == comm_handler->loc_dim_x + STENCIL_ORDER * 2
+    init_mesh(A, comm_handler);
+    init_mesh(B, comm_handler);
+    init_mesh(C, comm_handler);
+}
+
+/// Returns the core dimension along `axis` (0 for X, 1 for Y, 2 for Z) of the rank `id`.
+static usz neighbour_dim(comm_handler_t const* comm_handler, i32 id, u32 axis, usz dim_x, usz dim_y, usz dim_z) {
+    i32 comm_size;
+    MPI_Comm_size(comm_handler->comm, &comm_size);
+    comm_handler_t const other = comm_handler_new(comm_handler->comm, (u32)id, (u32)comm_size, dim_x, dim_y, dim_z);
+    usz const dims[3] = { other.loc_dim_x, other.loc_dim_y, other.loc_dim_z };
+    return dims[axis];
+}
+
+/// Fills the indices the coefficients of an axis were computed at. The low ghost cells receive
+/// the last core planes of `low_source` (`low_dim` core planes), the high ones the first core
+/// planes of `high_source`; without a neighbour, ghost cells keep their own index.
+static void coef_axis_indices(usz* index, usz loc_dim, i32 low_source, usz low_dim, i32 high_source) {
+    usz const dim = loc_dim + 2 * STENCIL_ORDER;
+    for (usz i = 0; i < dim; ++i) {
+        index[i] = i;
+    }
+    for (usz g = 0; g < STENCIL_ORDER; ++g) {
+        if (low_source >= 0) {
+            index[g] = low_dim + g;
+        }
+        if (high_source >= 0) {
+            index[dim - STENCIL_ORDER + g] = STENCIL_ORDER + g;
+        }
+    }
+}
+
+coef_tables_t coef_tables_new(comm_handler_t const* comm_handler, usz dim_x, usz dim_y, usz dim_z) {
+    comm_handler_t const* ch = comm_handler;
+    coef_tables_t self = {
+        .dim_x = ch->loc_dim_x + 2 * STENCIL_ORDER,
+        .dim_y = ch->loc_dim_y + 2 * STENCIL_ORDER,
+        .dim_z = ch->loc_dim_z + 2 * STENCIL_ORDER,
+    };
+    self.x = malloc(sizeof(f64) * self.dim_x);
+    self.y = malloc(sizeof(f64) * self.dim_y);
+    self.z = malloc(sizeof(f64) * self.dim_z);
+    usz* index = malloc(sizeof(usz) * (self.dim_x + self.dim_y + self.dim_z));
+    if (NULL == self.x || NULL == self.y || NULL == self.z || NULL == index) {
+        error("failed to allocate coefficient tables of %zu values", self.dim_x + self.dim_y + self.dim_z);
+    }
+
+    // Same sources as `comm_handler_ghost_exchange`: X from left/right, Y from bottom/top and
+    // Z from front/back
+    usz* index_x = index;
+    usz* index_y = index_x + self.dim_x;
+    usz* index_z = index_y + self.dim_y;
+    coef_axis_indices(
+        index_x, ch->loc_dim_x, ch->id_left,
+        ch->id_left >= 0 ? neighbour_dim(ch, ch->id_left, 0, dim_x, dim_y, dim_z) : 0, ch->id_right
     );
-    assert(
-        A->dim_y == B->dim_y && B->dim_y == C->dim_y &&
-        C->dim_y == comm_handler->loc_dim_y + STENCIL_ORDER * 2
+    coef_axis_indices(
+        index_y, ch->loc_dim_y, ch->id_bottom,
+        ch->id_bottom >= 0 ? neighbour_dim(ch, ch->id_bottom, 1, dim_x, dim_y, dim_z) : 0, ch->id_top
     );
-    assert(
-        A->dim_z == B->dim_z && B->dim_z == C->dim_z &&
-        C->dim_z == comm_handler->loc_dim_z + STENCIL_ORDER * 2
+    coef_axis_indices(
+        index_z, ch->loc_dim_z, ch->id_front,
+        ch->id_front >= 0 ? neighbour_dim(ch, ch->id_front, 2, dim_x, dim_y, dim_z) : 0, ch->id_back
     );
 
-    setup_mesh_cell_kinds(A);
-    setup_mesh_cell_kinds(B);
-    setup_mesh_cell_kinds(C);
+    // Same factors as the initialization of B
+    for (usz i = 0; i < self.dim_x; ++i) {
+        self.x[i] = cos((f64)index_x[i] + 0.311);
+    }
+    for (usz j = 0; j < self.dim_y; ++j) {
+        self.y[j] = cos((f64)index_y[j] + 0.817);
+    }
+    for (usz k = 0; k < self.dim_z; ++k) {
+        self.z[k] = (f64)index_z[k];
+    }
+    free(index);
+    return self;
+}
 
-    setup_mesh_cell_values(A, comm_handler);
-    setup_mesh_cell_values(B, comm_handler);
-    setup_mesh_cell_values(C, comm_handler);
+void coef_tables_drop(coef_tables_t* self) {
+    free(self->x);
+    free(self->y);
+    free(self->z);
+    *self = (coef_tables_t){ 0 };
 }
@@ -1,9 +1,12 @@
 #include "stencil/mesh.h"
 
 #include "logging.h"
+#include "stencil/trace.h"
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 mesh_t mesh_new(usz dim_x, usz dim_y, usz dim_z, mesh_kind_t kind)
 {
@@ -19,15 +22,33 @@ mesh_t mesh_new(usz dim_x, usz dim_y, usz dim_z, mesh_kind_t kind)
         .value = value,
         .kind_cell = kind_cell,
         .kind = kind,
+        .layout = MESH_LAYOUT_ROW_MAJOR,
+        .bricks_y = 0,
+        .bricks_z = 0,
+        .mapping = NULL,
+        .mapping_len = 0,
     };
 }
 
-void mesh_drop(mesh_t *self)
+/// Releases the storage of the values, whether it was allocated or mapped from a file.
+static void mesh_release_values(mesh_t *self)
 {
-    if (NULL != self->value)
+    if (NULL != self->mapping)
+    {
+        munmap(self->mapping, self->mapping_len);
+        self->mapping = NULL;
+        self->mapping_len = 0;
+    }
+    else if (NULL != self->value)
     {
         free(self->value);
     }
+    self->value = NULL;
+}
+
+void mesh_drop(mesh_t *self)
+{
+    mesh_release_values(self);
 
     if (NULL != self->kind_cell)
     {
@@ -57,7 +78,6 @@ void mesh_print(mesh_t const *self, char const *name)
         self->dim_y,
         self->dim_z);
 
-    f64(*restrict span_value)[self->dim_y][self->dim_z] = (f64(*)[self->dim_y][self->dim_z])self->value;
     cell_kind_t(*restrict span_kind)[self->dim_y][self->dim_z] = (cell_kind_t(*)[self->dim_y][self->dim_z])self->kind_cell;
 
     for (usz i = 0; i < self->dim_x; ++i)
@@ -68,8 +88,8 @@ void mesh_print(mesh_t const *self, char const *name)
             {
                 printf(
                     "%s%6.3lf%s ",
-                    CELL_KIND_CORE == span_kind[i][j][k] ? "\x1b[1m" : "",
-                    span_value[i][j][k],
+                    NULL != self->kind_cell && CELL_KIND_CORE == span_kind[i][j][k] ? "\x1b[1m" : "",
+                    idx_const(self, i, j, k),
                     "\x1b[0m");
             }
             puts("");
@@ -79,11 +99,135 @@ void mesh_print(mesh_t const *self, char const *name)
 }
 
 
+static char const *MESH_LAYOUTS_STR[] = {
+    "row_major",
+    "bricked",
+};
+
+char const *mesh_layout_as_str(mesh_layout_t layout)
+{
+    return MESH_LAYOUTS_STR[(usz)layout];
+}
+
+/// Returns the number of contiguous values starting at `k` in the current layout, up to `z1`.
+static inline usz mesh_run_len(mesh_t const *self, usz k, usz z1)
+{
+    if (MESH_LAYOUT_ROW_MAJOR == self->layout)
+        return z1 - k;
+    usz const brick_end = (k | (BRICK_DIM - 1)) + 1;
+    return (brick_end < z1 ? brick_end : z1) - k;
+}
+
+usz mesh_len(mesh_t const *self)
+{
+    if (MESH_LAYOUT_ROW_MAJOR == self->layout)
+        return self->dim_x * self->dim_y * self->dim_z;
+    usz const bricks_x = (self->dim_x + BRICK_DIM - 1) >> BRICK_SHIFT;
+    return bricks_x * self->bricks_y * self->bricks_z * BRICK_SIZE;
+}
+
+void mesh_set_layout(mesh_t *self, mesh_layout_t layout)
+{
+    if (self->layout == layout)
+    {
+        return;
+    }
+
+    mesh_t dst = *self;
+    dst.layout = layout;
+    if (MESH_LAYOUT_BRICKED == layout)
+    {
+        // Ghost cells are exactly one brick wide, trailing bricks are padded
+        dst.bricks_y = (self->dim_y + BRICK_DIM - 1) >> BRICK_SHIFT;
+        dst.bricks_z = (self->dim_z + BRICK_DIM - 1) >> BRICK_SHIFT;
+    }
+    else
+    {
+        dst.bricks_y = 0;
+        dst.bricks_z = 0;
+    }
+    usz const len = mesh_len(&dst);
+    dst.value = aligned_alloc(32, sizeof(f64) * len);
+    if (NULL == dst.value)
+    {
+        error("failed to allocate %zu bytes for mesh layout conversion", sizeof(f64) * len);
+    }
+    // Padding values are never read but keep them deterministic
+    memset(dst.value, 0, sizeof(f64) * len);
+
+    #pragma omp parallel for schedule(static)
+    for (usz i = 0; i < self->dim_x; ++i)
+        for (usz j = 0; j < self->dim_y; ++j)
+            for (usz k = 0; k < self->dim_z;)
+            {
+                usz const run = mesh_run_len(self, k, self->dim_z);
+                usz const dst_run = mesh_run_len(&dst, k, self->dim_z);
+                usz const n = run < dst_run ? run : dst_run;
+                memcpy(&dst.value[mesh_offset(&dst, i, j, k)], &self->value[mesh_offset(self, i, j, k)], sizeof(f64) * n);
+                k += n;
+            }
+
+    mesh_release_values(self);
+    dst.mapping = NULL;
+    dst.mapping_len = 0;
+    *self = dst;
+}
+
+usz mesh_pack(mesh_t const *self, f64 *buf, usz x0, usz x1, usz y0, usz y1, usz z0, usz z1)
+{
+    usz n = 0;
+    for (usz i = x0; i < x1; ++i)
+        for (usz j = y0; j < y1; ++j)
+            for (usz k = z0; k < z1;)
+            {
+                usz const run = mesh_run_len(self, k, z1);
+                memcpy(&buf[n], &self->value[mesh_offset(self, i, j, k)], sizeof(f64) * run);
+                n += run;
+                k += run;
+            }
+    return n;
+}
+
+usz mesh_unpack(mesh_t *self, f64 const *buf, usz x0, usz x1, usz y0, usz y1, usz z0, usz z1)
+{
+    usz n = 0;
+    for (usz i = x0; i < x1; ++i)
+        for (usz j = y0; j < y1; ++j)
+            for (usz k = z0; k < z1;)
+            {
+                usz const run = mesh_run_len(self, k, z1);
+                memcpy(&self->value[mesh_offset(self, i, j, k)], &buf[n], sizeof(f64) * run);
+                n += run;
+                k += run;
+            }
+    return n;
+}
+
 void mesh_copy_core(mesh_t *dst, mesh_t const *src)
 {
     assert(dst->dim_x == src->dim_x);
     assert(dst->dim_y == src->dim_y);
     assert(dst->dim_z == src->dim_z);
+    assert(dst->layout == src->layout);
+
+    u64 const begin = trace_begin();
+    if (MESH_LAYOUT_BRICKED == dst->layout)
+    {
+        usz const z1 = dst->dim_z - STENCIL_ORDER;
+
+        #pragma omp parallel for schedule(static)
+        for (usz i = STENCIL_ORDER; i < dst->dim_x - STENCIL_ORDER; ++i)
+            for (usz j = STENCIL_ORDER; j < dst->dim_y - STENCIL_ORDER; ++j)
+                for (usz k = STENCIL_ORDER; k < z1;)
+                {
+                    usz const run = mesh_run_len(dst, k, z1);
+                    usz const off = mesh_offset(dst, i, j, k);
+                    memcpy(&dst->value[off], &src->value[off], sizeof(f64) * run);
+                    k += run;
+                }
+        trace_end("copy", "copy", NULL, 0, begin);
+        return;
+    }
 
     f64(*restrict dst_value)[dst->dim_y][dst->dim_z] = (f64(*)[dst->dim_y][dst->dim_z])dst->value;
     f64(*restrict src_value)[dst->dim_y][dst->dim_z] = (f64(*)[dst->dim_y][dst->dim_z])src->value;
@@ -92,5 +236,25 @@ void mesh_copy_core(mesh_t *dst, mesh_t const *src)
         for (usz j = STENCIL_ORDER; j < dst->dim_y - STENCIL_ORDER; ++j)
             for (usz k = STENCIL_ORDER; k < dst->dim_z - STENCIL_ORDER; ++k)
                 dst_value[i][j][k] = src_value[i][j][k];
+    trace_end("copy", "copy", NULL, 0, begin);
+}
+
+f64 *idx(mesh_t *self, usz i, usz j, usz k)
+{
+    return &self->value[mesh_offset(self, i, j, k)];
+}
 
+f64 *idx_core(mesh_t *self, usz i, usz j, usz k)
+{
+    return idx(self, i + STENCIL_ORDER, j + STENCIL_ORDER, k + STENCIL_ORDER);
+}
+
+f64 idx_const(mesh_t const *self, usz i, usz j, usz k)
+{
+    return self->value[mesh_offset(self, i, j, k)];
+}
+
+f64 idx_core_const(mesh_t const *self, usz i, usz j, usz k)
+{
+    return idx_const(self, i + STENCIL_ORDER, j + STENCIL_ORDER, k + STENCIL_ORDER);
 }
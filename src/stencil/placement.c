@@ -0,0 +1,228 @@
+#include "stencil/placement.h"
+
+#include "logging.h"
+#include "stencil/comm_handler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Faces of a block, in the order of `comm_handler_ghost_exchange`: left, right, top, bottom,
+/// front, back. Face `f ^ 1` is the opposite of face `f`.
+#define NB_FACES 6
+
+/// Halo graph of the process grid: the neighbour of each grid rank across each face (-1 if
+/// none) and the bytes sent to it by one exchange of a mesh.
+typedef struct halo_graph_s {
+    u32 size;
+    i32 (*peer)[NB_FACES];
+    u64 (*bytes)[NB_FACES];
+} halo_graph_t;
+
+static halo_graph_t halo_graph_new(MPI_Comm comm, u32 size, usz dim_x, usz dim_y, usz dim_z) {
+    halo_graph_t self = {
+        .size = size,
+        .peer = malloc(sizeof(i32[NB_FACES]) * size),
+        .bytes = malloc(sizeof(u64[NB_FACES]) * size),
+    };
+    if (NULL == self.peer || NULL == self.bytes) {
+        error("failed to allocate the halo graph of %u ranks", size);
+    }
+
+    for (u32 g = 0; g < size; ++g) {
+        comm_handler_t const ch = comm_handler_new(comm, g, size, dim_x, dim_y, dim_z);
+        // Faces span the ghost-inclusive extents of the other axes
+        u64 const mx = ch.loc_dim_x + 2 * STENCIL_ORDER;
+        u64 const my = ch.loc_dim_y + 2 * STENCIL_ORDER;
+        u64 const mz = ch.loc_dim_z + 2 * STENCIL_ORDER;
+        u64 const face[3] = {
+            STENCIL_ORDER * my * mz * sizeof(f64),
+            mx * STENCIL_ORDER * mz * sizeof(f64),
+            mx * my * STENCIL_ORDER * sizeof(f64),
+        };
+        i32 const peer[NB_FACES] = { ch.id_left, ch.id_right, ch.id_top, ch.id_bottom, ch.id_front, ch.id_back };
+        for (usz f = 0; f < NB_FACES; ++f) {
+            self.peer[g][f] = peer[f];
+            self.bytes[g][f] = peer[f] >= 0 ? face[f / 2] : 0;
+        }
+    }
+    return self;
+}
+
+static void halo_graph_drop(halo_graph_t* self) {
+    free(self->peer);
+    free(self->bytes);
+}
+
+/// Splits the halo traffic of the grid into on-node and cross-node bytes, grid rank `g` being
+/// held by node `node_of[g]`.
+static placement_traffic_t halo_traffic(halo_graph_t const* graph, u32 const* node_of) {
+    placement_traffic_t traffic = { 0 };
+    for (u32 g = 0; g < graph->size; ++g) {
+        for (usz f = 0; f < NB_FACES; ++f) {
+            i32 const peer = graph->peer[g][f];
+            if (peer < 0) {
+                continue;
+            }
+            if (node_of[g] == node_of[peer]) {
+                traffic.intra += graph->bytes[g][f];
+            } else {
+                traffic.inter += graph->bytes[g][f];
+            }
+        }
+    }
+    return traffic;
+}
+
+/// Returns the node of every rank of `comm`, nodes being numbered by their lowest rank
+/// (collective).
+static u32* rank_nodes(MPI_Comm comm, usz node_size, u32* nb_nodes) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm, &comm_size);
+
+    i32 leader = rank;
+    if (node_size > 0) {
+        leader = rank - rank % (i32)node_size;
+    } else {
+        MPI_Comm node_comm;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+        MPI_Allreduce(&rank, &leader, 1, MPI_INT, MPI_MIN, node_comm);
+        MPI_Comm_free(&node_comm);
+    }
+
+    i32* leaders = malloc(sizeof(i32) * (usz)comm_size);
+    u32* node = malloc(sizeof(u32) * (usz)comm_size);
+    if (NULL == leaders || NULL == node) {
+        error("failed to allocate the nodes of %d ranks", comm_size);
+    }
+    MPI_Allgather(&leader, 1, MPI_INT, leaders, 1, MPI_INT, comm);
+
+    // A leader comes before the other ranks of its node
+    *nb_nodes = 0;
+    for (i32 r = 0; r < comm_size; ++r) {
+        node[r] = (leaders[r] == r) ? (*nb_nodes)++ : node[leaders[r]];
+    }
+    free(leaders);
+    return node;
+}
+
+/// Grows one block of the grid per node: from the lowest free grid rank, repeatedly adds the
+/// free grid rank exchanging the most bytes with the block so far, until the node is full.
+/// Returns the node of each grid rank.
+static u32* grow_blocks(halo_graph_t const* graph, u32 const* capacity, u32 nb_nodes) {
+    u32 const size = graph->size;
+    u32* node_of = malloc(sizeof(u32) * size);
+    u64* gain = malloc(sizeof(u64) * size);
+    if (NULL == node_of || NULL == gain) {
+        error("failed to allocate the placement of %u ranks", size);
+    }
+    for (u32 g = 0; g < size; ++g) {
+        node_of[g] = UINT32_MAX;
+    }
+
+    for (u32 n = 0; n < nb_nodes; ++n) {
+        memset(gain, 0, sizeof(u64) * size);
+        for (u32 filled = 0; filled < capacity[n]; ++filled) {
+            // Ties go to the lowest grid rank, which also seeds the block
+            u32 best = UINT32_MAX;
+            for (u32 g = 0; g < size; ++g) {
+                if (UINT32_MAX == node_of[g] && (UINT32_MAX == best || gain[g] > gain[best])) {
+                    best = g;
+                }
+            }
+            node_of[best] = n;
+            for (usz f = 0; f < NB_FACES; ++f) {
+                i32 const peer = graph->peer[best][f];
+                if (peer >= 0) {
+                    gain[peer] += graph->bytes[best][f] + graph->bytes[peer][f ^ 1];
+                }
+            }
+        }
+    }
+    free(gain);
+    return node_of;
+}
+
+placement_t placement_new(MPI_Comm comm, usz dim_x, usz dim_y, usz dim_z, usz node_size) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm, &comm_size);
+    u32 const size = (u32)comm_size;
+
+    placement_t self = { 0 };
+    u32* rank_node = rank_nodes(comm, node_size, &self.nb_nodes);
+    halo_graph_t graph = halo_graph_new(comm, size, dim_x, dim_y, dim_z);
+
+    // With the launcher's numbering, rank g holds grid rank g
+    self.before = halo_traffic(&graph, rank_node);
+
+    u32* capacity = calloc(self.nb_nodes, sizeof(u32));
+    if (NULL == capacity) {
+        error("failed to allocate the capacity of %u nodes", self.nb_nodes);
+    }
+    for (u32 r = 0; r < size; ++r) {
+        capacity[rank_node[r]] += 1;
+    }
+    u32* node_of = grow_blocks(&graph, capacity, self.nb_nodes);
+    self.after = halo_traffic(&graph, node_of);
+
+    // The ranks of a node take the grid ranks of its block in the same order
+    i32 key = rank;
+    self.reordered = self.after.inter < self.before.inter;
+    if (self.reordered) {
+        u32 const index = (u32)rank;
+        u32 nth = 0;
+        for (u32 r = 0; r < index; ++r) {
+            nth += (rank_node[r] == rank_node[index]);
+        }
+        for (u32 g = 0; g < size; ++g) {
+            if (node_of[g] == rank_node[index] && 0 == nth--) {
+                key = (i32)g;
+                break;
+            }
+        }
+    } else {
+        self.after = self.before;
+    }
+    MPI_Comm_split(comm, 0, key, &self.comm);
+
+    free(node_of);
+    free(capacity);
+    halo_graph_drop(&graph);
+    free(rank_node);
+    return self;
+}
+
+void placement_drop(placement_t* self) {
+    MPI_Comm_free(&self->comm);
+}
+
+void placement_print(placement_t const* self) {
+    i32 rank;
+    MPI_Comm_rank(self->comm, &rank);
+    if (0 != rank) {
+        return;
+    }
+
+    f64 const mib = 1.0 / (1024.0 * 1024.0);
+    placement_traffic_t const* before = &self->before;
+    placement_traffic_t const* after = &self->after;
+    fprintf(
+        stderr,
+        "****************************************\n"
+        "         RANK PLACEMENT\n"
+        "Nodes .............................. %u\n"
+        "Halo per exchange (launcher) ....... %.3lf MiB on-node, %.3lf MiB across nodes\n"
+        "Halo per exchange (placement) ...... %.3lf MiB on-node, %.3lf MiB across nodes%s\n",
+        self->nb_nodes,
+        (f64)before->intra * mib,
+        (f64)before->inter * mib,
+        (f64)after->intra * mib,
+        (f64)after->inter * mib,
+        self->reordered ? "" : " (launcher numbering kept)"
+    );
+}
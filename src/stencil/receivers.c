@@ -0,0 +1,225 @@
+#include "stencil/receivers.h"
+
+#include "logging.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Coordinates are broadcast as `MPI_UINT64_T`
+_Static_assert(sizeof(usz) == sizeof(u64), "usz is not 64-bit wide");
+
+/// Reads the receivers of a file, skipping the ones outside of the global mesh.
+static usz read_receivers(char const* path, usz dim_x, usz dim_y, usz dim_z, usz (**points)[3]) {
+    FILE* fp = fopen(path, "rb");
+    if (NULL == fp) {
+        error("failed to open receivers file `%s`", path);
+    }
+
+    usz cap = 64;
+    usz len = 0;
+    usz(*pts)[3] = malloc(sizeof(usz[3]) * cap);
+    char line[256];
+    usz line_num = 0;
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        line_num += 1;
+        char* hash = strchr(line, '#');
+        if (NULL != hash) {
+            *hash = '\0';
+        }
+        usz x, y, z;
+        i32 const n = sscanf(line, "%zu %zu %zu", &x, &y, &z);
+        if (n <= 0) {
+            continue;
+        }
+        if (3 != n) {
+            warn("malformed receiver at line %zu in file %s, skipped", line_num, path);
+            continue;
+        }
+        if (x >= dim_x || y >= dim_y || z >= dim_z) {
+            warn("receiver (%zu,%zu,%zu) at line %zu is outside of the mesh, skipped", x, y, z, line_num);
+            continue;
+        }
+        if (len == cap) {
+            cap *= 2;
+            pts = realloc(pts, sizeof(usz[3]) * cap);
+        }
+        pts[len][0] = x;
+        pts[len][1] = y;
+        pts[len][2] = z;
+        len += 1;
+    }
+
+    fclose(fp);
+    *points = pts;
+    return len;
+}
+
+receivers_t receivers_new(
+    char const* path, char const* output_path, usz chunk, comm_handler_t const* comm_handler
+) {
+    i32 rank;
+    MPI_Comm_rank(comm_handler->comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm_handler->comm, &comm_size);
+
+    receivers_t self = {
+        .comm = comm_handler->comm,
+        .rank = rank,
+        .chunk = chunk > 0 ? chunk : 1,
+    };
+
+    // Global dimensions are only known through the decomposition of the last rank of each axis
+    usz glob_dim[3] = {
+        comm_handler->coord_x + comm_handler->loc_dim_x,
+        comm_handler->coord_y + comm_handler->loc_dim_y,
+        comm_handler->coord_z + comm_handler->loc_dim_z,
+    };
+    MPI_Allreduce(MPI_IN_PLACE, glob_dim, 3, MPI_UINT64_T, MPI_MAX, self.comm);
+
+    usz(*all)[3] = NULL;
+    u64 nb_global = 0;
+    if (0 == rank) {
+        nb_global = read_receivers(path, glob_dim[0], glob_dim[1], glob_dim[2], &all);
+    }
+    MPI_Bcast(&nb_global, 1, MPI_UINT64_T, 0, self.comm);
+    if (0 != rank) {
+        all = malloc(sizeof(usz[3]) * (nb_global > 0 ? nb_global : 1));
+    }
+    MPI_Bcast(all, (i32)(3 * nb_global), MPI_UINT64_T, 0, self.comm);
+    self.nb_global = nb_global;
+
+    // Ownership is decided once, with the same test as `session_probe_local`
+    usz const lo[3] = { comm_handler->coord_x, comm_handler->coord_y, comm_handler->coord_z };
+    usz const hi[3] = {
+        lo[0] + comm_handler->loc_dim_x,
+        lo[1] + comm_handler->loc_dim_y,
+        lo[2] + comm_handler->loc_dim_z,
+    };
+    i32* owned = malloc(sizeof(i32) * (nb_global > 0 ? nb_global : 1));
+    self.points = malloc(sizeof(usz[3]) * (nb_global > 0 ? nb_global : 1));
+    for (usz r = 0; r < nb_global; ++r) {
+        bool const mine = all[r][0] >= lo[0] && all[r][0] < hi[0] && all[r][1] >= lo[1] &&
+                          all[r][1] < hi[1] && all[r][2] >= lo[2] && all[r][2] < hi[2];
+        owned[r] = mine ? rank : -1;
+        if (mine) {
+            memcpy(self.points[self.nb_local], all[r], sizeof(usz[3]));
+            self.nb_local += 1;
+        }
+    }
+    self.trace = malloc(sizeof(f64) * self.chunk * (self.nb_local > 0 ? self.nb_local : 1));
+
+    // Rank 0 learns where each receiver lands in a gathered step
+    i32 const nb_local = (i32)self.nb_local;
+    if (0 == rank) {
+        self.nb_owned = malloc(sizeof(i32) * (usz)comm_size);
+        self.owned_displ = malloc(sizeof(i32) * (usz)comm_size);
+        self.owner_index = malloc(sizeof(usz) * (nb_global > 0 ? nb_global : 1));
+        self.gathered = malloc(sizeof(f64) * self.chunk * (nb_global > 0 ? nb_global : 1));
+    }
+    MPI_Gather(&nb_local, 1, MPI_INT, self.nb_owned, 1, MPI_INT, 0, self.comm);
+    MPI_Reduce(0 == rank ? MPI_IN_PLACE : owned, owned, (i32)nb_global, MPI_INT, MPI_MAX, 0, self.comm);
+    if (0 == rank) {
+        i32 displ = 0;
+        for (i32 r = 0; r < comm_size; ++r) {
+            self.owned_displ[r] = displ;
+            displ += self.nb_owned[r];
+        }
+        // Receivers of a rank are gathered in file order
+        usz* next = calloc((usz)comm_size, sizeof(usz));
+        for (usz r = 0; r < nb_global; ++r) {
+            if (owned[r] < 0) {
+                error("receiver (%zu,%zu,%zu) is not owned by any rank", all[r][0], all[r][1], all[r][2]);
+            }
+            self.owner_index[r] = next[owned[r]]++;
+        }
+        free(next);
+        self.owner = owned;
+        owned = NULL;
+
+        self.ofp = fopen(output_path, "wb");
+        if (NULL == self.ofp) {
+            error("failed to open seismogram file `%s`", output_path);
+        }
+        fprintf(self.ofp, "# %zu receivers (x y z), then one line per step: step value...\n", self.nb_global);
+        for (usz r = 0; r < nb_global; ++r) {
+            fprintf(self.ofp, "# %zu %zu %zu\n", all[r][0], all[r][1], all[r][2]);
+        }
+    }
+
+    free(owned);
+    free(all);
+    return self;
+}
+
+void receivers_drop(receivers_t* self) {
+    receivers_flush(self);
+    if (NULL != self->ofp) {
+        fclose(self->ofp);
+    }
+    free(self->points);
+    free(self->trace);
+    free(self->nb_owned);
+    free(self->owned_displ);
+    free(self->owner);
+    free(self->owner_index);
+    free(self->gathered);
+    *self = (receivers_t){ 0 };
+}
+
+void receivers_record(receivers_t* self, f64 const* samples) {
+    memcpy(&self->trace[self->nb_steps * self->nb_local], samples, sizeof(f64) * self->nb_local);
+    self->nb_steps += 1;
+    if (self->nb_steps == self->chunk) {
+        receivers_flush(self);
+    }
+}
+
+void receivers_flush(receivers_t* self) {
+    if (0 == self->nb_steps) {
+        return;
+    }
+
+    // Each rank sends its samples step-major; counts scale with the number of buffered steps
+    usz const nb_steps = self->nb_steps;
+    i32* counts = NULL;
+    i32* displs = NULL;
+    if (0 == self->rank) {
+        i32 comm_size;
+        MPI_Comm_size(self->comm, &comm_size);
+        counts = malloc(sizeof(i32) * (usz)comm_size);
+        displs = malloc(sizeof(i32) * (usz)comm_size);
+        for (i32 r = 0; r < comm_size; ++r) {
+            counts[r] = (i32)nb_steps * self->nb_owned[r];
+            displs[r] = (i32)nb_steps * self->owned_displ[r];
+        }
+    }
+    MPI_Gatherv(
+        self->trace,
+        (i32)(nb_steps * self->nb_local),
+        MPI_DOUBLE,
+        self->gathered,
+        counts,
+        displs,
+        MPI_DOUBLE,
+        0,
+        self->comm
+    );
+
+    if (0 == self->rank) {
+        for (usz s = 0; s < nb_steps; ++s) {
+            fprintf(self->ofp, "%zu", self->step_offset + s);
+            for (usz r = 0; r < self->nb_global; ++r) {
+                i32 const owner = self->owner[r];
+                usz const at = (usz)displs[owner] + s * (usz)self->nb_owned[owner] + self->owner_index[r];
+                fprintf(self->ofp, " %+.15le", self->gathered[at]);
+            }
+            fputc('\n', self->ofp);
+        }
+        fflush(self->ofp);
+        free(counts);
+        free(displs);
+    }
+
+    self->step_offset += nb_steps;
+    self->nb_steps = 0;
+}
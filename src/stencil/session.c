@@ -0,0 +1,673 @@
+#include "stencil/session.h"
+
+#include "logging.h"
+#include "stencil/coef_cache.h"
+#include "stencil/dataflow.h"
+#include "stencil/init.h"
+#include "stencil/solve.h"
+#include "stencil/trace.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Prints the memory bandwidth reached by the kernel, aggregated over all ranks.
+static void print_bandwidth_report(session_t const* self) {
+    config_t const* cfg = &self->cfg;
+    mesh_t const* A = &self->A;
+    f64 const niter = (f64)self->total_iter;
+    f64 const kernel_s = self->regions[SESSION_REGION_KERNEL].secs;
+    f64 loc_bytes = (f64)solve_compulsory_bytes(cfg->kernel, A) * niter;
+    f64 loc_reads = solve_read_amplification(cfg->kernel, A);
+    f64 loc_points = (f64)((A->dim_x - 2 * STENCIL_ORDER) * (A->dim_y - 2 * STENCIL_ORDER)
+                         * (A->dim_z - 2 * STENCIL_ORDER));
+    f64 loc_model = solve_modelled_bytes(cfg->kernel, A) * niter;
+    // Measured traffic is one cache line per last-level cache miss of the kernel region
+    i32 loc_measured = cfg->counters && self->counters.available[COUNTER_LLC_MISSES] ? 1 : 0;
+    f64 loc_dram = self->regions[SESSION_REGION_KERNEL].value[COUNTER_LLC_MISSES] * 64.0;
+    f64 glob_bytes;
+    f64 glob_kernel_s;
+    f64 glob_reads;
+    f64 glob_points;
+    f64 glob_model;
+    i32 glob_measured;
+    f64 glob_dram;
+
+    i32 const rank = self->rank;
+    i32 const comm_size = self->comm_size;
+    MPI_Comm const comm = self->comm_handler.comm;
+    MPI_Reduce(&loc_bytes, &glob_bytes, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&kernel_s, &glob_kernel_s, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&loc_reads, &glob_reads, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&loc_points, &glob_points, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&loc_model, &glob_model, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&loc_measured, &glob_measured, 1, MPI_INT, MPI_MIN, 0, comm);
+    MPI_Reduce(&loc_dram, &glob_dram, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+    if (rank == 0) {
+        char measured[48] = "not measured (needs counters=1)";
+        if (cfg->counters) {
+            snprintf(measured, sizeof(measured), "not measured (no LLC-miss counter)");
+        }
+        if (glob_measured) {
+            snprintf(measured, sizeof(measured), "%.1lf B measured", glob_dram / niter / glob_points);
+        }
+        fprintf(
+            stderr,
+            "\n****************************************\n"
+            "         KERNEL BANDWIDTH (%s)\n"
+            "Kernel time ........................ %.3lf ms/iter\n"
+            "Compulsory traffic ................. %.3lf MiB/iter\n"
+            "Effective bandwidth ................ %.3lf GB/s\n"
+            "Modelled reads per input point ..... %.2lf\n"
+            "DRAM traffic per point ............. %.1lf B modelled, %s\n",
+            solver_kind_as_str(cfg->kernel),
+            glob_kernel_s * 1.0e+3 / niter,
+            glob_bytes / niter / (1024.0 * 1024.0),
+            glob_bytes / glob_kernel_s * 1.0e-9,
+            glob_reads / (f64)comm_size,
+            glob_model / niter / glob_points,
+            measured
+        );
+    }
+}
+
+/// Prints the hardware counters of each region summed over all ranks, with derived metrics.
+static void print_counters_report(session_t const* self) {
+    counters_t const* counters = &self->counters;
+    counters_region_t const* regions = self->regions;
+    mesh_t const* A = &self->A;
+    f64 const niter = (f64)self->total_iter;
+    i32 const rank = self->rank;
+    MPI_Comm const comm = self->comm_handler.comm;
+
+    // A counter is only reported if every rank could open it
+    i32 loc_available[COUNTER_COUNT];
+    i32 glob_available[COUNTER_COUNT];
+    for (usz c = 0; c < COUNTER_COUNT; ++c) {
+        loc_available[c] = counters->available[c] ? 1 : 0;
+    }
+    MPI_Reduce(loc_available, glob_available, COUNTER_COUNT, MPI_INT, MPI_MIN, 0, comm);
+
+    if (rank == 0) {
+        fprintf(
+            stderr,
+            "\n****************************************\n"
+            "         HARDWARE COUNTERS (all ranks)\n"
+            "%-16s %10s %7s %9s %10s %9s %8s\n",
+            "region", "ms/iter", "IPC", "GFLOP/s", "LLC-miss/s", "DRAM GB/s", "FLOP/B"
+        );
+    }
+
+    for (usz r = 0; r < SESSION_REGION_COUNT; ++r) {
+        f64 glob_value[COUNTER_COUNT];
+        f64 glob_secs;
+        MPI_Reduce(regions[r].value, glob_value, COUNTER_COUNT, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(&regions[r].secs, &glob_secs, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+        if (rank != 0) {
+            continue;
+        }
+
+        // DRAM traffic is approximated by one cache line per last-level cache miss
+        f64 const dram_bytes = glob_value[COUNTER_LLC_MISSES] * 64.0;
+        char ipc[16] = "-", gflops[16] = "-", misses[16] = "-", dram[16] = "-", intensity[16] = "-";
+        if (glob_available[COUNTER_CYCLES] && glob_available[COUNTER_INSTRUCTIONS]) {
+            snprintf(ipc, sizeof(ipc), "%.2lf", glob_value[COUNTER_INSTRUCTIONS] / glob_value[COUNTER_CYCLES]);
+        }
+        if (glob_available[COUNTER_FLOPS]) {
+            snprintf(gflops, sizeof(gflops), "%.2lf", glob_value[COUNTER_FLOPS] / glob_secs * 1.0e-9);
+        }
+        if (glob_available[COUNTER_LLC_MISSES]) {
+            snprintf(misses, sizeof(misses), "%.3le", glob_value[COUNTER_LLC_MISSES] / glob_secs);
+            snprintf(dram, sizeof(dram), "%.2lf", dram_bytes / glob_secs * 1.0e-9);
+        }
+        if (glob_available[COUNTER_FLOPS] && glob_available[COUNTER_LLC_MISSES]) {
+            snprintf(intensity, sizeof(intensity), "%.3lf", glob_value[COUNTER_FLOPS] / dram_bytes);
+        }
+        fprintf(
+            stderr,
+            "%-16s %10.3lf %7s %9s %10s %9s %8s\n",
+            regions[r].name,
+            glob_secs * 1.0e+3 / niter,
+            ipc,
+            gflops,
+            misses,
+            dram,
+            intensity
+        );
+    }
+
+    if (rank == 0) {
+        // Compare FLOP/B with the machine balance (peak FLOP/s over peak DRAM bandwidth):
+        // below it the kernel is bandwidth-bound, above it compute-bound
+        usz const core_points = (A->dim_x - 2 * STENCIL_ORDER) * (A->dim_y - 2 * STENCIL_ORDER)
+                              * (A->dim_z - 2 * STENCIL_ORDER);
+        fprintf(
+            stderr,
+            "Kernel model: %zu FLOP/point, %.3lf FLOP/B at compulsory traffic\n",
+            (usz)(1 + 8 * 13),
+            (f64)(core_points * (1 + 8 * 13)) / (f64)solve_compulsory_bytes(self->cfg.kernel, A)
+        );
+    }
+}
+
+/// Prints the orders used by the approximate mode, its error bound and, when the full order is
+/// computed alongside, the deviation actually reached.
+static void print_approx_report(session_t const* self) {
+    session_approx_t const* approx = &self->approx;
+    MPI_Comm const comm = self->comm_handler.comm;
+
+    // Over the core only: ghost cells beyond the last exchange depth are stale by design
+    f64 deviation = 0.0;
+    if (self->cfg.approx_check) {
+        mesh_t const* A = &self->A;
+        mesh_t const* A_full = &approx->A_full;
+        #pragma omp parallel for collapse(2) reduction(max: deviation)
+        for (usz i = STENCIL_ORDER; i < A->dim_x - STENCIL_ORDER; ++i) {
+            for (usz j = STENCIL_ORDER; j < A->dim_y - STENCIL_ORDER; ++j) {
+                for (usz k = STENCIL_ORDER; k < A->dim_z - STENCIL_ORDER; ++k) {
+                    deviation = fmax(deviation, fabs(idx_const(A, i, j, k) - idx_const(A_full, i, j, k)));
+                }
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &deviation, 1, MPI_DOUBLE, MPI_MAX, comm);
+    }
+    if (0 != self->rank) {
+        return;
+    }
+
+    char orders[256] = "";
+    usz len = 0;
+    usz taps = 0;
+    for (usz o = 1; o <= STENCIL_ORDER; ++o) {
+        len += (usz)snprintf(orders + len, sizeof(orders) - len, "%s%zu:%zu", 1 == o ? "" : " ", o, approx->iters[o]);
+        taps += o * approx->iters[o];
+    }
+    char measured[64] = "not measured (approx_check=0)";
+    if (self->cfg.approx_check) {
+        snprintf(measured, sizeof(measured), "%.3le", deviation);
+    }
+    fprintf(
+        stderr,
+        "\n****************************************\n"
+        "         APPROXIMATE MODE\n"
+        "Tolerance per iteration ............ %.3le\n"
+        "Iterations per order ............... %s\n"
+        "Halo and taps saved ................ %.1lf%%\n"
+        "Accumulated error bound ............ %.3le\n"
+        "Deviation from full order .......... %s\n",
+        self->cfg.approx,
+        orders,
+        100.0 * (1.0 - (f64)taps / (f64)(STENCIL_ORDER * self->total_iter)),
+        approx->bound,
+        measured
+    );
+}
+
+/// Largest |B| of a mesh, whatever its layout.
+static f64 mesh_max_abs(mesh_t const* mesh) {
+    usz const len = mesh->dim_x * mesh->dim_y * mesh->dim_z;
+    f64 max_abs = 0.0;
+    #pragma omp parallel for reduction(max: max_abs)
+    for (usz i = 0; i < len; ++i) {
+        max_abs = fmax(max_abs, fabs(mesh->value[i]));
+    }
+    return max_abs;
+}
+
+/// Measures the initial field to pick the order of the first iteration (collective).
+static void session_approx_init(session_t* self) {
+    session_approx_t* approx = &self->approx;
+    MPI_Comm const comm = self->comm_handler.comm;
+
+    f64 max_product[2] = {
+        solve_max_product(&self->A, &self->B, false),
+        solve_max_product(&self->A, &self->B, true),
+    };
+    MPI_Allreduce(MPI_IN_PLACE, max_product, 2, MPI_DOUBLE, MPI_MAX, comm);
+    approx->max_ghost = max_product[0];
+    approx->max_product = fmax(max_product[0], max_product[1]);
+    approx->order = solve_truncated_order(approx->max_product, self->cfg.approx);
+    approx->bound = 0.0;
+    for (usz o = 0; o <= STENCIL_ORDER; ++o) {
+        approx->iters[o] = 0;
+    }
+
+    if (self->cfg.approx_check) {
+        init_mesh(&approx->A_full, &self->comm_handler);
+        init_mesh(&approx->C_full, &self->comm_handler);
+        comm_handler_ghost_exchange(&self->comm_handler, &approx->A_full);
+        comm_handler_ghost_exchange(&self->comm_handler, &approx->C_full);
+    }
+}
+
+/// One iteration of the approximate mode (collective).
+static solve_diag_t session_approx_step(session_t* self) {
+    session_approx_t* approx = &self->approx;
+    comm_handler_t const* ch = &self->comm_handler;
+    usz const order = approx->order;
+
+    counters_region_start(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+    u64 begin = trace_begin();
+    solve_diag_t diag;
+    f64 max_product = solve_jacobi_truncated(&self->A, &self->B, &self->C, order, &diag);
+    trace_end("step", "kernel", "order", (i64)order, begin);
+    counters_region_stop(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+
+    // The order of the next iteration sets how deep its ghost cells must be exchanged. C is
+    // never read by the kernel and does not need an exchange.
+    counters_region_start(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+    begin = trace_begin();
+    MPI_Allreduce(MPI_IN_PLACE, &max_product, 1, MPI_DOUBLE, MPI_MAX, ch->comm);
+    approx->bound = approx->lipschitz * approx->bound
+                  + solve_truncation_error(order, approx->max_product);
+    approx->iters[order] += 1;
+    approx->max_product = fmax(max_product, approx->max_ghost);
+    approx->order = solve_truncated_order(approx->max_product, self->cfg.approx);
+    comm_handler_ghost_exchange_depth(ch, &self->A, approx->order);
+    trace_end("step", "ghost exchange", "depth", (i64)approx->order, begin);
+    counters_region_stop(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+
+    if (self->cfg.approx_check) {
+        solve_jacobi(&approx->A_full, &self->B, &approx->C_full);
+        comm_handler_ghost_exchange(ch, &approx->A_full);
+        comm_handler_ghost_exchange(ch, &approx->C_full);
+    }
+    return diag;
+}
+
+/// One iteration of the bulk-synchronous mode (collective).
+static solve_diag_t session_bulk_step(session_t* self) {
+    // Compute Jacobi C=B@A (one iteration)
+    counters_region_start(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+    u64 begin = trace_begin();
+    solve_diag_t diag;
+    if (SOLVER_KIND_MATRIX_FREE == self->cfg.kernel) {
+        diag = solve_jacobi_matrix_free(&self->A, &self->coef, &self->C);
+    } else {
+        diag = solve_jacobi_with(self->cfg.kernel, &self->A, &self->B, &self->C, &self->workspace);
+    }
+    trace_end("step", "kernel", "iter", (i64)self->iter, begin);
+    counters_region_stop(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+
+    // Exchange ghost cells for A and C meshes
+    // No need to exchange B as its a constant mesh
+    counters_region_start(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+    begin = trace_begin();
+    comm_handler_ghost_exchange(&self->comm_handler, &self->A);
+    comm_handler_ghost_exchange(&self->comm_handler, &self->C);
+    trace_end("step", "ghost exchange", "iter", (i64)self->iter, begin);
+    counters_region_stop(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+    return diag;
+}
+
+/// Completes the diagnostics reduction in flight and prints it on rank 0. Once the field has
+/// diverged past `diag_abort`, aborts every rank (collective).
+static void session_diag_complete(session_t* self) {
+    session_diag_t* diag = &self->diag;
+    MPI_Comm const comm = self->comm_handler.comm;
+    if (!diag->pending) {
+        return;
+    }
+    MPI_Waitall(2, diag->requests, MPI_STATUSES_IGNORE);
+    diag->pending = false;
+
+    f64 const max_abs = diag->recv_max;
+    u64 const nonfinite = (u64)diag->recv_sum[1];
+    if (0 == self->rank) {
+        fprintf(
+            stderr,
+            "Field at step %zu: L2 norm %.6le, max |A| %.6le, %lu non-finite values\n",
+            diag->pending_iter,
+            sqrt(diag->recv_sum[0]),
+            max_abs,
+            nonfinite
+        );
+    }
+
+    f64 const limit = self->cfg.diag_abort;
+    if (limit > 0.0 && (nonfinite > 0 || max_abs > limit)) {
+        // Every rank reached the same verdict: rank 0 reports it and tears the job down
+        if (0 == self->rank) {
+            warn("field diverged at step %zu: max |A| %.3le (threshold %.3le), %lu non-finite values, aborting",
+                 diag->pending_iter, max_abs, limit, nonfinite);
+            MPI_Abort(comm, EXIT_FAILURE);
+        }
+        MPI_Barrier(comm);
+    }
+}
+
+/// Hands the current window over to a non-blocking reduction across ranks (collective).
+static void session_diag_start(session_t* self) {
+    session_diag_t* diag = &self->diag;
+    MPI_Comm const comm = self->comm_handler.comm;
+
+    diag->send_sum[0] = diag->window.sum_sq;
+    diag->send_sum[1] = (f64)diag->window.nonfinite;
+    diag->send_max = diag->window.max_abs;
+    MPI_Iallreduce(diag->send_sum, diag->recv_sum, 2, MPI_DOUBLE, MPI_SUM, comm, &diag->requests[0]);
+    MPI_Iallreduce(&diag->send_max, &diag->recv_max, 1, MPI_DOUBLE, MPI_MAX, comm, &diag->requests[1]);
+    diag->pending = true;
+    diag->pending_iter = self->iter;
+    diag->window = (solve_diag_t){ 0 };
+    diag->window_iters = 0;
+}
+
+/// Adds the diagnostics of the iteration just computed to the window. Every `diag` iterations,
+/// completes the previous reduction and starts reducing the window (collective).
+static void session_diag_record(session_t* self, solve_diag_t const* step) {
+    session_diag_t* diag = &self->diag;
+    diag->window.sum_sq = step->sum_sq;
+    diag->window.max_abs = fmax(diag->window.max_abs, step->max_abs);
+    diag->window.nonfinite += step->nonfinite;
+    diag->window_iters += 1;
+    if (diag->window_iters < self->cfg.diag) {
+        return;
+    }
+
+    counters_region_start(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+    u64 const begin = trace_begin();
+    session_diag_complete(self);
+    session_diag_start(self);
+    trace_end("step", "diagnostics", "iter", (i64)self->iter, begin);
+    counters_region_stop(&self->counters, &self->regions[SESSION_REGION_EXCHANGE]);
+}
+
+/// Completes the reduction in flight, then reduces what is left of the window (collective).
+static void session_diag_flush(session_t* self) {
+    session_diag_complete(self);
+    if (self->diag.window_iters > 0) {
+        session_diag_start(self);
+        session_diag_complete(self);
+    }
+}
+
+/// Brings A and C to the state expected at the start of a run: initialized and ghost cells
+/// exchanged, in place in the configured layout.
+static void session_init_field(session_t* self) {
+    init_mesh(&self->A, &self->comm_handler);
+    init_mesh(&self->C, &self->comm_handler);
+
+    comm_handler_ghost_exchange(&self->comm_handler, &self->A);
+    comm_handler_ghost_exchange(&self->comm_handler, &self->C);
+    self->iter = 0;
+
+    if (self->approx.enabled) {
+        session_approx_init(self);
+    }
+    if (self->subdomains.nb > 0) {
+        subdomains_scatter(&self->subdomains, &self->A, &self->C);
+    }
+}
+
+session_t session_new(config_t const* cfg, MPI_Comm comm) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm, &comm_size);
+
+    session_t self = {
+        .cfg = *cfg,
+        .rank = rank,
+        .comm_size = comm_size,
+        .comm_handler =
+            comm_handler_new(comm, (u32)rank, (u32)comm_size, cfg->dim_x, cfg->dim_y, cfg->dim_z),
+        .regions = {
+            [SESSION_REGION_KERNEL] = counters_region_new("kernel"),
+            [SESSION_REGION_EXCHANGE] = counters_region_new("ghost exchange"),
+        },
+    };
+    comm_handler_t const* ch = &self.comm_handler;
+
+    self.A = mesh_new(ch->loc_dim_x, ch->loc_dim_y, ch->loc_dim_z, MESH_KIND_INPUT);
+    self.C = mesh_new(ch->loc_dim_x, ch->loc_dim_y, ch->loc_dim_z, MESH_KIND_OUTPUT);
+    // Converted before initialization so that resets never leave the layout
+    mesh_set_layout(&self.A, cfg->layout);
+    mesh_set_layout(&self.C, cfg->layout);
+
+    // The matrix-free kernel only replaces the bulk-synchronous row-major iteration, the other
+    // modes read B
+    if (SOLVER_KIND_MATRIX_FREE == cfg->kernel
+        && (EXEC_MODE_BULK != cfg->exec || MESH_LAYOUT_ROW_MAJOR != cfg->layout || cfg->approx > 0.0
+            || cfg->subdomains > 1)) {
+        warn("rank %d: the `%s` kernel requires `%s` execution, the `%s` layout, no approximation and no "
+             "sub-domains, using `%s`",
+             rank, solver_kind_as_str(SOLVER_KIND_MATRIX_FREE), exec_mode_as_str(EXEC_MODE_BULK),
+             mesh_layout_as_str(MESH_LAYOUT_ROW_MAJOR), solver_kind_as_str(SOLVER_KIND_BLOCKED));
+        self.cfg.kernel = SOLVER_KIND_BLOCKED;
+    }
+    if (SOLVER_KIND_MATRIX_FREE == self.cfg.kernel) {
+        // B is never stored: its per-axis factors are all the kernel reads
+        self.coef = coef_tables_new(ch, cfg->dim_x, cfg->dim_y, cfg->dim_z);
+    } else {
+        // B is constant: initialize and exchange it once for the lifetime of the session, or map
+        // it from the cache. The exchange is collective so either every rank hits or none does.
+        bool const use_cache = '\0' != cfg->coef_cache_dir[0];
+        i32 loc_hit = use_cache && coef_cache_map(cfg->coef_cache_dir, cfg, ch, &self.B);
+        i32 glob_hit;
+        MPI_Allreduce(&loc_hit, &glob_hit, 1, MPI_INT, MPI_LAND, comm);
+        if (!glob_hit) {
+            if (loc_hit) {
+                mesh_drop(&self.B);
+            }
+            self.B = mesh_new(ch->loc_dim_x, ch->loc_dim_y, ch->loc_dim_z, MESH_KIND_CONSTANT);
+            init_mesh(&self.B, ch);
+            comm_handler_ghost_exchange(ch, &self.B);
+            if (use_cache) {
+                coef_cache_store(cfg->coef_cache_dir, cfg, ch, &self.B);
+            }
+        }
+#ifndef NDEBUG
+        if (use_cache && 0 == rank) {
+            info("coefficient cache %s", glob_hit ? "hit" : "miss");
+        }
+#endif
+        mesh_set_layout(&self.B, cfg->layout);
+    }
+
+    // The truncated kernels are row-major, iteration by iteration
+    if (cfg->approx > 0.0) {
+        if (EXEC_MODE_BULK != cfg->exec || MESH_LAYOUT_ROW_MAJOR != cfg->layout) {
+            warn("rank %d: approximate mode requires `%s` execution and the `%s` layout, disabled",
+                 rank, exec_mode_as_str(EXEC_MODE_BULK), mesh_layout_as_str(MESH_LAYOUT_ROW_MAJOR));
+        } else {
+            self.approx.enabled = true;
+            f64 max_b = mesh_max_abs(&self.B);
+            MPI_Allreduce(MPI_IN_PLACE, &max_b, 1, MPI_DOUBLE, MPI_MAX, comm);
+            self.approx.lipschitz = max_b * (1.0 + solve_truncation_error(0, 1.0));
+            if (cfg->approx_check) {
+                self.approx.A_full = mesh_new(ch->loc_dim_x, ch->loc_dim_y, ch->loc_dim_z, MESH_KIND_INPUT);
+                self.approx.C_full = mesh_new(ch->loc_dim_x, ch->loc_dim_y, ch->loc_dim_z, MESH_KIND_OUTPUT);
+            }
+        }
+    }
+
+    // Slabs run the row-major kernels one iteration at a time
+    if (cfg->subdomains > 1) {
+        if (EXEC_MODE_BULK != cfg->exec || MESH_LAYOUT_ROW_MAJOR != cfg->layout || cfg->approx > 0.0) {
+            warn("rank %d: sub-domains require `%s` execution, the `%s` layout and no approximation, disabled",
+                 rank, exec_mode_as_str(EXEC_MODE_BULK), mesh_layout_as_str(MESH_LAYOUT_ROW_MAJOR));
+        } else {
+            // Message tags only match if every rank has as many slabs
+            u64 nb = cfg->subdomains;
+            u64 const thickest = ch->loc_dim_x / STENCIL_ORDER;
+            nb = nb < thickest ? nb : thickest;
+            MPI_Allreduce(MPI_IN_PLACE, &nb, 1, MPI_UINT64_T, MPI_MIN, comm);
+            if (nb < cfg->subdomains && 0 == rank) {
+                warn("slabs must be at least %lu planes thick, using %zu sub-domains per rank",
+                     STENCIL_ORDER, nb);
+            }
+            if (nb > 1) {
+                self.subdomains = subdomains_new(ch, nb, &self.B);
+            }
+        }
+    }
+    // Slabs are thinner than the block of the rank, one workspace serves them all. Bricked meshes
+    // always use the bricked kernel, which needs none.
+    if (MESH_LAYOUT_ROW_MAJOR == cfg->layout) {
+        self.workspace = solve_workspace_new(self.cfg.kernel, &self.A);
+    }
+    session_init_field(&self);
+
+    if (EXEC_MODE_TASKS == cfg->exec && !dataflow_supported(&self.A)) {
+        warn("rank %d: falling back to `%s` execution", rank, exec_mode_as_str(EXEC_MODE_BULK));
+        self.cfg.exec = EXEC_MODE_BULK;
+    }
+
+    if (cfg->counters && !counters_init(&self.counters)) {
+        warn("rank %d: no hardware counter available, only timing regions", rank);
+    }
+
+    // Kernels measure each iteration as a whole, which neither overlapped mode exposes
+    if (cfg->diag > 0) {
+        if (EXEC_MODE_BULK != self.cfg.exec || self.subdomains.nb > 0) {
+            warn("rank %d: field diagnostics require `%s` execution and no sub-domains, disabled",
+                 rank, exec_mode_as_str(EXEC_MODE_BULK));
+        } else {
+            self.diag.enabled = true;
+        }
+    }
+
+    // Only the time loop is traced
+    if ('\0' != cfg->trace_file[0]) {
+        trace_init(cfg->trace_events);
+    }
+
+    return self;
+}
+
+void session_drop(session_t* self) {
+    mesh_drop(&self->A);
+    mesh_drop(&self->B);
+    mesh_drop(&self->C);
+    solve_workspace_drop(&self->workspace);
+    if (SOLVER_KIND_MATRIX_FREE == self->cfg.kernel) {
+        coef_tables_drop(&self->coef);
+    }
+    if (self->subdomains.nb > 0) {
+        subdomains_drop(&self->subdomains);
+    }
+    if (self->approx.enabled && self->cfg.approx_check) {
+        mesh_drop(&self->approx.A_full);
+        mesh_drop(&self->approx.C_full);
+    }
+    if (self->cfg.counters) {
+        counters_drop(&self->counters);
+    }
+    if ('\0' != self->cfg.trace_file[0]) {
+        trace_write(self->cfg.trace_file, self->comm_handler.comm);
+        trace_drop();
+    }
+}
+
+void session_step(session_t* self, usz niter) {
+    session_step_probed(self, niter, 0, NULL, NULL);
+}
+
+void session_step_probed(
+    session_t* self, usz niter, usz nb_points, usz const (*points)[3], f64* values
+) {
+    comm_handler_t const* ch = &self->comm_handler;
+    usz(*local)[3] = malloc(sizeof(usz[3]) * (nb_points > 0 ? nb_points : 1));
+    for (usz p = 0; p < nb_points; ++p) {
+        assert(points[p][0] >= ch->coord_x && points[p][0] < ch->coord_x + ch->loc_dim_x);
+        assert(points[p][1] >= ch->coord_y && points[p][1] < ch->coord_y + ch->loc_dim_y);
+        assert(points[p][2] >= ch->coord_z && points[p][2] < ch->coord_z + ch->loc_dim_z);
+        local[p][0] = points[p][0] - ch->coord_x + STENCIL_ORDER;
+        local[p][1] = points[p][1] - ch->coord_y + STENCIL_ORDER;
+        local[p][2] = points[p][2] - ch->coord_z + STENCIL_ORDER;
+    }
+
+    if (EXEC_MODE_TASKS == self->cfg.exec) {
+        // Kernel and halo messages overlap, the whole graph is accounted to the kernel
+        counters_region_start(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+        u64 const begin = trace_begin();
+        dataflow_run(ch, &self->A, &self->B, &self->C, niter, nb_points, (usz const(*)[3])local, values);
+        trace_end("step", "task graph", "iters", (i64)niter, begin);
+        counters_region_stop(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+
+        self->iter += niter;
+        self->total_iter += niter;
+        free(local);
+        return;
+    }
+
+    if (self->subdomains.nb > 0) {
+        // Slabs overlap their kernels with the messages of the others, the whole run is
+        // accounted to the kernel
+        counters_region_start(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+        u64 const begin = trace_begin();
+        subdomains_run(&self->subdomains, ch, self->cfg.kernel, &self->workspace, niter, nb_points, (usz const(*)[3])local, values);
+        subdomains_gather(&self->subdomains, &self->A);
+        trace_end("step", "subdomains", "iters", (i64)niter, begin);
+        counters_region_stop(&self->counters, &self->regions[SESSION_REGION_KERNEL]);
+
+        self->iter += niter;
+        self->total_iter += niter;
+        free(local);
+        return;
+    }
+
+    for (usz it = 0; it < niter; ++it) {
+        solve_diag_t diag;
+        if (self->approx.enabled) {
+            diag = session_approx_step(self);
+        } else {
+            diag = session_bulk_step(self);
+        }
+
+        for (usz p = 0; p < nb_points; ++p) {
+            values[it * nb_points + p] = idx_const(&self->A, local[p][0], local[p][1], local[p][2]);
+        }
+
+        self->iter += 1;
+        self->total_iter += 1;
+        if (self->diag.enabled) {
+            session_diag_record(self, &diag);
+        }
+    }
+    free(local);
+}
+
+bool session_probe_local(session_t const* self, usz x, usz y, usz z, f64* value) {
+    comm_handler_t const* ch = &self->comm_handler;
+    if (x < ch->coord_x || x >= ch->coord_x + ch->loc_dim_x || y < ch->coord_y ||
+        y >= ch->coord_y + ch->loc_dim_y || z < ch->coord_z || z >= ch->coord_z + ch->loc_dim_z) {
+        return false;
+    }
+    *value = idx_core_const(&self->A, x - ch->coord_x, y - ch->coord_y, z - ch->coord_z);
+    return true;
+}
+
+f64 session_probe(session_t const* self, usz x, usz y, usz z) {
+    // Exactly one rank owns the point, the others contribute an exact zero
+    f64 loc_value = 0.0;
+    session_probe_local(self, x, y, z, &loc_value);
+    f64 glob_value;
+    MPI_Allreduce(&loc_value, &glob_value, 1, MPI_DOUBLE, MPI_SUM, self->comm_handler.comm);
+    return glob_value;
+}
+
+void session_reset(session_t* self) {
+    if (self->diag.enabled) {
+        session_diag_flush(self);
+    }
+    session_init_field(self);
+}
+
+void session_report(session_t* self) {
+    if (self->diag.enabled) {
+        session_diag_flush(self);
+    }
+    if (0 == self->total_iter) {
+        return;
+    }
+    print_bandwidth_report(self);
+    if (self->cfg.counters) {
+        print_counters_report(self);
+    }
+    if (self->approx.enabled) {
+        print_approx_report(self);
+    }
+}
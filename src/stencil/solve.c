@@ -1,8 +1,14 @@
 #include "stencil/solve.h"
 
+#include "logging.h"
+#include "stencil/trace.h"
+
 #include <assert.h>
 #include <immintrin.h>
 #include <math.h>
+#include <omp.h>
+#include <string.h>
+#include <unistd.h>
 
 #define min(a, b)               \
 	({                          \
@@ -15,9 +21,162 @@ usz BI = 8;
 usz BJ = 8;
 usz BK = 4096;
 
+/// Tile sizes of the streaming kernel on the Y and Z axes (0 selects them from the cache size).
+usz SJ = 0;
+usz SK = 0;
+
+static char const* SOLVER_KINDS_STR[] = {
+    "blocked",
+    "streaming",
+    "split",
+    "matrix_free",
+};
+
+char const* solver_kind_as_str(solver_kind_t kind)
+{
+    return SOLVER_KINDS_STR[(usz)kind];
+}
+
+bool solver_kind_from_str(char const* str, solver_kind_t* kind)
+{
+    for (usz i = 0; i < countof(SOLVER_KINDS_STR); ++i)
+    {
+        if (strcmp(SOLVER_KINDS_STR[i], str) == 0)
+        {
+            *kind = (solver_kind_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/// Returns the linear index of the tile starting at `(ii, jj, kk)` in a `ti x tj x tk` tiling of
+/// the core, as reported in traces.
+static inline i64 tile_index(usz ii, usz jj, usz kk, usz ti, usz tj, usz tk, usz dim_y, usz dim_z)
+{
+    usz const nj = (dim_y - 2 * STENCIL_ORDER + tj - 1) / tj;
+    usz const nk = (dim_z - 2 * STENCIL_ORDER + tk - 1) / tk;
+    return (i64)((((ii - STENCIL_ORDER) / ti) * nj + (jj - STENCIL_ORDER) / tj) * nk + (kk - STENCIL_ORDER) / tk);
+}
+
+/// Returns 1 if `v` is a NaN or an infinity. Tested on the exponent bits: `-ffast-math` assumes
+/// finite values and folds `isfinite` to true.
+static inline u64 non_finite(f64 v)
+{
+    u64 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x7ff0000000000000UL) == 0x7ff0000000000000UL;
+}
+
+static inline void diag_merge(solve_diag_t *into, solve_diag_t const *from)
+{
+    into->sum_sq += from->sum_sq;
+    into->max_abs = fmax(into->max_abs, from->max_abs);
+    into->nonfinite += from->nonfinite;
+}
+
+#pragma omp declare reduction(diag : solve_diag_t : diag_merge(&omp_out, &omp_in)) initializer(omp_priv = (solve_diag_t){ 0 })
 
-#pragma omp declare simd 
-void solve_jacobi(mesh_t *A, mesh_t const *B, mesh_t *C)
+/// Weights of the neighbours at distance `o + 1`.
+static void jacobi_weights(f64 pow17[static STENCIL_ORDER])
+{
+    for (usz o = 0; o < STENCIL_ORDER; ++o)
+        pow17[o] = 1.0 / pow(17.0, (f64)(o + 1));
+}
+
+/// Computes the points of the box `[i0, i1) x [j0, j1) x [k0, k1)` of C (ghost-inclusive
+/// coordinates, row-major meshes) with the taps up to distance `order`, and returns the
+/// diagnostics of the written points.
+/// Always inlined so that each constant `order` yields a fully unrolled kernel.
+static inline __attribute__((always_inline)) solve_diag_t jacobi_box_order(
+    mesh_t const *A, mesh_t const *B, mesh_t *C, f64 const pow17[static STENCIL_ORDER], usz order,
+    usz i0, usz i1, usz j0, usz j1, usz k0, usz k1)
+{
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64(*restrict B_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])B->value;
+    f64(*restrict C_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])C->value;
+    f64 sum_sq = 0.0;
+    f64 max_abs = 0.0;
+    u64 nonfinite = 0;
+
+    for (usz i = i0; i < i1; ++i)
+    {
+        for (usz j = j0; j < j1; ++j)
+        {
+            #pragma omp simd aligned(A_span_value, B_span_value, C_span_value:32) reduction(+: sum_sq, nonfinite) reduction(max: max_abs)
+            for (usz k = k0; k < k1; ++k)
+            {
+                f64 sum = A_span_value[i][j][k] * B_span_value[i][j][k];
+
+                #pragma GCC unroll 8
+                for (usz o = 1; o <= order; ++o)
+                {
+                    sum += (A_span_value[i + o][j][k] * B_span_value[i + o][j][k]
+                          + A_span_value[i - o][j][k] * B_span_value[i - o][j][k]
+                          + A_span_value[i][j + o][k] * B_span_value[i][j + o][k]
+                          + A_span_value[i][j - o][k] * B_span_value[i][j - o][k]
+                          + A_span_value[i][j][k + o] * B_span_value[i][j][k + o]
+                          + A_span_value[i][j][k - o] * B_span_value[i][j][k - o] ) * pow17[o - 1];
+                }
+
+                C_span_value[i][j][k] = sum;
+                sum_sq += sum * sum;
+                max_abs = fmax(max_abs, fabs(sum));
+                nonfinite += non_finite(sum);
+            }
+        }
+    }
+    return (solve_diag_t){ .sum_sq = sum_sq, .max_abs = max_abs, .nonfinite = nonfinite };
+}
+
+static inline solve_diag_t jacobi_box(
+    mesh_t const *A, mesh_t const *B, mesh_t *C, f64 const pow17[static STENCIL_ORDER],
+    usz i0, usz i1, usz j0, usz j1, usz k0, usz k1)
+{
+    return jacobi_box_order(A, B, C, pow17, STENCIL_ORDER, i0, i1, j0, j1, k0, k1);
+}
+
+typedef solve_diag_t jacobi_box_fn(
+    mesh_t const *A, mesh_t const *B, mesh_t *C, f64 const pow17[static STENCIL_ORDER],
+    usz i0, usz i1, usz j0, usz j1, usz k0, usz k1);
+
+/// Kernel specialised for the taps up to distance `N`.
+#define DEFINE_JACOBI_BOX_ORDER(N)                                                              \
+    static solve_diag_t jacobi_box_order##N(                                                    \
+        mesh_t const *A, mesh_t const *B, mesh_t *C, f64 const pow17[static STENCIL_ORDER],     \
+        usz i0, usz i1, usz j0, usz j1, usz k0, usz k1)                                         \
+    {                                                                                           \
+        return jacobi_box_order(A, B, C, pow17, N, i0, i1, j0, j1, k0, k1);                     \
+    }
+
+DEFINE_JACOBI_BOX_ORDER(1)
+DEFINE_JACOBI_BOX_ORDER(2)
+DEFINE_JACOBI_BOX_ORDER(3)
+DEFINE_JACOBI_BOX_ORDER(4)
+DEFINE_JACOBI_BOX_ORDER(5)
+DEFINE_JACOBI_BOX_ORDER(6)
+DEFINE_JACOBI_BOX_ORDER(7)
+DEFINE_JACOBI_BOX_ORDER(8)
+
+_Static_assert(STENCIL_ORDER == 8, "one specialised kernel is needed per order");
+
+static jacobi_box_fn *const JACOBI_BOX_ORDERS[STENCIL_ORDER + 1] = {
+    NULL,
+    jacobi_box_order1,
+    jacobi_box_order2,
+    jacobi_box_order3,
+    jacobi_box_order4,
+    jacobi_box_order5,
+    jacobi_box_order6,
+    jacobi_box_order7,
+    jacobi_box_order8,
+};
+
+solve_diag_t solve_jacobi(mesh_t *A, mesh_t const *B, mesh_t *C)
 {
 	assert(A->dim_x == B->dim_x && B->dim_x == C->dim_x);
 	assert(A->dim_y == B->dim_y && B->dim_y == C->dim_y);
@@ -27,16 +186,60 @@ void solve_jacobi(mesh_t *A, mesh_t const *B, mesh_t *C)
     usz const dim_y = A->dim_y;
     usz const dim_z = A->dim_z;
 
-    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
-    f64(*restrict B_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])B->value;
-    f64(*restrict C_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])C->value;
+    f64 pow17[STENCIL_ORDER];
+    jacobi_weights(pow17);
+    solve_diag_t diag = { 0 };
+
+	#pragma omp parallel for schedule(dynamic) reduction(diag: diag)
+    for (usz ii = STENCIL_ORDER; ii < dim_x - STENCIL_ORDER; ii += BI)
+    {
+        for (usz jj = STENCIL_ORDER; jj < dim_y - STENCIL_ORDER; jj += BJ)
+        {
+            for (usz kk = STENCIL_ORDER; kk < dim_z - STENCIL_ORDER; kk += BK)
+            {
+                usz min_i = min(ii + BI, dim_x - STENCIL_ORDER);
+                usz min_j = min(jj + BJ, dim_y - STENCIL_ORDER);
+                usz min_k = min(kk + BK, dim_z - STENCIL_ORDER);
+
+                u64 const begin = trace_begin();
+                solve_diag_t const tile = jacobi_box(A, B, C, pow17, ii, min_i, jj, min_j, kk, min_k);
+                diag_merge(&diag, &tile);
+                trace_end("kernel", "tile", "tile", tile_index(ii, jj, kk, BI, BJ, BK, dim_y, dim_z), begin);
+            }
+        }
+    }
+    mesh_copy_core(A, C);
+    return diag;
+}
+
+solve_diag_t solve_jacobi_box(
+    mesh_t const *A, mesh_t const *B, mesh_t *C, usz i0, usz i1, usz j0, usz j1, usz k0, usz k1)
+{
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout && MESH_LAYOUT_ROW_MAJOR == C->layout);
+    assert(i0 >= STENCIL_ORDER && i1 <= A->dim_x - STENCIL_ORDER);
+    assert(j0 >= STENCIL_ORDER && j1 <= A->dim_y - STENCIL_ORDER);
+    assert(k0 >= STENCIL_ORDER && k1 <= A->dim_z - STENCIL_ORDER);
 
     f64 pow17[STENCIL_ORDER];
+    jacobi_weights(pow17);
+    return jacobi_box(A, B, C, pow17, i0, i1, j0, j1, k0, k1);
+}
 
-	for (usz o = 0; o < STENCIL_ORDER; ++o)
-        pow17[o] = 1.0 / pow(17.0, (f64)(o + 1));
+f64 solve_jacobi_truncated(mesh_t *A, mesh_t const *B, mesh_t *C, usz order, solve_diag_t *diag)
+{
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout && MESH_LAYOUT_ROW_MAJOR == C->layout);
+    assert(order >= 1 && order <= STENCIL_ORDER);
 
-	#pragma omp parallel for schedule(dynamic)
+    usz const dim_x = A->dim_x;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+
+    f64 pow17[STENCIL_ORDER];
+    jacobi_weights(pow17);
+    jacobi_box_fn *const box = JACOBI_BOX_ORDERS[order];
+    solve_diag_t loc_diag = { 0 };
+
+    #pragma omp parallel for schedule(dynamic) reduction(diag: loc_diag)
     for (usz ii = STENCIL_ORDER; ii < dim_x - STENCIL_ORDER; ii += BI)
     {
         for (usz jj = STENCIL_ORDER; jj < dim_y - STENCIL_ORDER; jj += BJ)
@@ -47,32 +250,757 @@ void solve_jacobi(mesh_t *A, mesh_t const *B, mesh_t *C)
                 usz min_j = min(jj + BJ, dim_y - STENCIL_ORDER);
                 usz min_k = min(kk + BK, dim_z - STENCIL_ORDER);
 
-                for (usz i = ii; i < min_i; ++i)
+                u64 const begin = trace_begin();
+                solve_diag_t const tile = box(A, B, C, pow17, ii, min_i, jj, min_j, kk, min_k);
+                diag_merge(&loc_diag, &tile);
+                trace_end("kernel", "tile", "tile", tile_index(ii, jj, kk, BI, BJ, BK, dim_y, dim_z), begin);
+            }
+        }
+    }
+
+    // Copy back into A, measuring the products the next iteration starts from on the way
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64(*restrict B_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])B->value;
+    f64(*restrict C_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])C->value;
+    f64 max_product = 0.0;
+    u64 const begin = trace_begin();
+
+    #pragma omp parallel for collapse(2) reduction(max: max_product)
+    for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
+    {
+        for (usz j = STENCIL_ORDER; j < dim_y - STENCIL_ORDER; ++j)
+        {
+            #pragma omp simd reduction(max: max_product)
+            for (usz k = STENCIL_ORDER; k < dim_z - STENCIL_ORDER; ++k)
+            {
+                f64 const v = C_span_value[i][j][k];
+                A_span_value[i][j][k] = v;
+                max_product = fmax(max_product, fabs(v * B_span_value[i][j][k]));
+            }
+        }
+    }
+    trace_end("copy", "copy", NULL, 0, begin);
+    *diag = loc_diag;
+    return max_product;
+}
+
+f64 solve_max_product(mesh_t const *A, mesh_t const *B, bool core)
+{
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout && MESH_LAYOUT_ROW_MAJOR == B->layout);
+
+    usz const dim_x = A->dim_x;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+    f64 max_product = 0.0;
+
+    #pragma omp parallel for collapse(2) reduction(max: max_product)
+    for (usz i = 0; i < dim_x; ++i)
+    {
+        for (usz j = 0; j < dim_y; ++j)
+        {
+            for (usz k = 0; k < dim_z; ++k)
+            {
+                bool const in_core = i >= STENCIL_ORDER && i < dim_x - STENCIL_ORDER
+                                  && j >= STENCIL_ORDER && j < dim_y - STENCIL_ORDER
+                                  && k >= STENCIL_ORDER && k < dim_z - STENCIL_ORDER;
+                if (in_core == core)
+                {
+                    usz const at = (i * dim_y + j) * dim_z + k;
+                    max_product = fmax(max_product, fabs(A->value[at] * B->value[at]));
+                }
+            }
+        }
+    }
+    return max_product;
+}
+
+f64 solve_truncation_error(usz order, f64 max_product)
+{
+    // Each dropped distance contributes 6 products, weighted by 1/17^o
+    f64 weights = 0.0;
+    for (usz o = STENCIL_ORDER; o > order; --o)
+        weights += 1.0 / pow(17.0, (f64)o);
+    return 6.0 * max_product * weights;
+}
+
+usz solve_truncated_order(f64 max_product, f64 tolerance)
+{
+    for (usz order = 1; order < STENCIL_ORDER; ++order)
+    {
+        if (solve_truncation_error(order, max_product) <= tolerance)
+            return order;
+    }
+    return STENCIL_ORDER;
+}
+
+/// Bytes of cache a thread may use for the rolling window of the streaming kernels.
+/// Only the private L2 is counted: the L3 is shared with the other cores, and virtual machines
+/// report the size of the whole host cache, so a share of it is no bound on what stays resident.
+static usz streaming_cache_budget(void)
+{
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    usz budget = (l2 > 0) ? (usz)l2 : 1UL << 20;
+    // Leave room for the rows of C, the hardware prefetchers and the other hyperthread
+    return budget / 2;
+}
+
+/// Values of a window plane of a `tj x tk` tile: the products over the star of the tile only,
+/// `STENCIL_ORDER` halo rows on each Y side over the tile columns and the tile rows over the Z
+/// halo too. The corners are never read so they are not stored.
+static inline usz window_plane_len(usz tj, usz tk)
+{
+    return 2 * STENCIL_ORDER * tk + tj * (tk + 2 * STENCIL_ORDER);
+}
+
+/// Offset in a window plane of the value at row `j` and column `k0` of the tile of rows
+/// `[j0, j1)` and `tk` columns from `k0`. Halo rows hold the `tk` tile columns, tile rows the
+/// `tk + 2 * STENCIL_ORDER` columns from `k0 - STENCIL_ORDER`.
+static inline usz window_row(usz j, usz j0, usz j1, usz tk)
+{
+    if (j < j0)
+        return (j + STENCIL_ORDER - j0) * tk;
+    if (j < j1)
+        return STENCIL_ORDER * tk + (j - j0) * (tk + 2 * STENCIL_ORDER) + STENCIL_ORDER;
+    return STENCIL_ORDER * tk + (j1 - j0) * (tk + 2 * STENCIL_ORDER) + (j - j1) * tk;
+}
+
+/// Picks the (Y,Z) tile of the streaming kernels so that the window of `2 * STENCIL_ORDER + 1`
+/// product planes of a tile fits in the cache budget of a thread. Each tile re-reads a Y halo
+/// over its columns and a Z halo over its rows, so `nj x nk` tiles add
+/// `2 * STENCIL_ORDER * (nj * core_z + nk * core_y)` reads: the tile counts minimizing it, which
+/// give near-square tiles, are searched exhaustively. Axes set with `SJ`/`SK` are kept.
+static void streaming_tile_size(usz core_y, usz core_z, usz* tj, usz* tk)
+{
+    usz const window = 2 * STENCIL_ORDER + 1;
+    usz const budget = streaming_cache_budget() / (window * sizeof(f64));
+
+    usz best = 0;
+    *tj = 0;
+    *tk = 0;
+    for (usz nj = 1; nj <= core_y; ++nj)
+    {
+        usz const sj = (SJ > 0) ? SJ : (core_y + nj - 1) / nj;
+        usz sk = SK;
+        if (0 == SK)
+        {
+            // Widest tile whose plane fits, then the same tile count with balanced widths
+            usz const halo = 2 * STENCIL_ORDER * sj;
+            usz max_k = (budget > halo) ? (budget - halo) / (sj + 2 * STENCIL_ORDER) : 0;
+            max_k = (max_k > 0) ? max_k : 1;
+            usz const nk = (core_z + max_k - 1) / max_k;
+            sk = (core_z + nk - 1) / nk;
+        }
+        usz const cost = (core_y + sj - 1) / sj * core_z + (core_z + sk - 1) / sk * core_y;
+        // Ties go to the longer Z rows, better for SIMD and prefetching
+        if (0 == *tj || cost < best || (cost == best && sk > *tk))
+        {
+            best = cost;
+            *tj = sj;
+            *tk = sk;
+        }
+        if (SJ > 0)
+            break;
+    }
+    *tj = min(*tj, core_y);
+    *tk = min(*tk, core_z);
+}
+
+/// Stores into `plane` the products A·B of the plane `i` over the star of the (Y,Z) tile of rows
+/// `[j0, j1)` and columns `[k0, k1)`, laid out as described by `window_row`. `coef` is what the
+/// kernel computes B from.
+typedef void window_plane_fn(
+    f64 *restrict plane, mesh_t const *A, void const *coef, usz i, usz j0, usz j1, usz k0, usz k1);
+
+/// Products of a plane read from a stored B (`coef` is the mesh B).
+static inline void streaming_plane(
+    f64 *restrict plane, mesh_t const *A, void const *coef, usz i, usz j0, usz j1, usz k0, usz k1)
+{
+    mesh_t const *B = coef;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64(*restrict B_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])B->value;
+
+    for (usz j = j0 - STENCIL_ORDER; j < j1 + STENCIL_ORDER; ++j)
+    {
+        bool const tile_row = j >= j0 && j < j1;
+        usz const lo = tile_row ? k0 - STENCIL_ORDER : k0;
+        usz const hi = tile_row ? k1 + STENCIL_ORDER : k1;
+        f64 *restrict row = &plane[window_row(j, j0, j1, k1 - k0) - k0];
+
+        #pragma omp simd
+        for (usz k = lo; k < hi; ++k)
+            row[k] = A_span_value[i][j][k] * B_span_value[i][j][k];
+    }
+}
+
+/// Marches every (Y,Z) tile along X, keeping the products A·B of its `2 * STENCIL_ORDER + 1`
+/// planes in a per-thread window that `fill` extends by one plane per step, then copies C back
+/// into A with the same static tile ownership so each thread re-reads the part of C it wrote.
+/// Always inlined so that `fill` is inlined into the march of each kernel.
+static inline __attribute__((always_inline)) solve_diag_t window_kernel(
+    mesh_t *A, void const *coef, window_plane_fn *fill, mesh_t *C)
+{
+    usz const dim_x = A->dim_x;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+    usz const window = 2 * STENCIL_ORDER + 1;
+
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64(*restrict C_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])C->value;
+
+    f64 pow17[STENCIL_ORDER];
+    jacobi_weights(pow17);
+
+    usz tj, tk;
+    streaming_tile_size(dim_y - 2 * STENCIL_ORDER, dim_z - 2 * STENCIL_ORDER, &tj, &tk);
+    // Slots are sized for a full tile, edge tiles use the start of theirs
+    usz const slot = window_plane_len(tj, tk);
+    solve_diag_t diag = { 0 };
+
+    #pragma omp parallel
+    {
+        // aligned_alloc wants a multiple of the alignment
+        usz const bytes = (sizeof(f64) * window * slot + 31) & ~(usz)31;
+        f64 *ring = aligned_alloc(32, bytes);
+        // Offset of each star row of the tile in a plane, indexed from its first halo row
+        usz *rows = malloc(sizeof(usz) * (tj + 2 * STENCIL_ORDER));
+        if (NULL == ring || NULL == rows)
+            error("failed to allocate %zu bytes for the product window", bytes);
+
+        #pragma omp for collapse(2) schedule(static) reduction(diag: diag)
+        for (usz jj = STENCIL_ORDER; jj < dim_y - STENCIL_ORDER; jj += tj)
+        {
+            for (usz kk = STENCIL_ORDER; kk < dim_z - STENCIL_ORDER; kk += tk)
+            {
+                usz max_j = min(jj + tj, dim_y - STENCIL_ORDER);
+                usz max_k = min(kk + tk, dim_z - STENCIL_ORDER);
+                u64 const begin = trace_begin();
+                f64 sum_sq = 0.0;
+                f64 max_abs = 0.0;
+                u64 nonfinite = 0;
+
+                // Plane p of the mesh lives in slot p % window, the first 2 * STENCIL_ORDER are
+                // needed before the first core plane
+                for (usz r = 0; r < max_j - jj + 2 * STENCIL_ORDER; ++r)
+                    rows[r] = window_row(jj + r - STENCIL_ORDER, jj, max_j, max_k - kk) - kk;
+                for (usz p = 0; p < 2 * STENCIL_ORDER; ++p)
+                    fill(&ring[(p % window) * slot], A, coef, p, jj, max_j, kk, max_k);
+
+                for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
                 {
-                    for (usz j = jj; j < min_j; ++j)
+                    usz const next = i + STENCIL_ORDER;
+                    fill(&ring[(next % window) * slot], A, coef, next, jj, max_j, kk, max_k);
+
+                    f64 const *plane[2 * STENCIL_ORDER + 1];
+                    for (usz o = 0; o < window; ++o)
+                        plane[o] = &ring[((i + o - STENCIL_ORDER) % window) * slot];
+                    f64 const *centre = plane[STENCIL_ORDER];
+
+                    for (usz j = jj; j < max_j; ++j)
                     {
-                        #pragma omp simd aligned(A_span_value, B_span_value, C_span_value:32)
-                        for (usz k = kk; k < min_k; ++k)
+                        // Rows of the star around row j, indexed by the mesh column
+                        usz const r = j - jj + STENCIL_ORDER;
+                        f64 const *row = centre + rows[r];
+                        f64 const *xp[STENCIL_ORDER], *xm[STENCIL_ORDER];
+                        f64 const *yp[STENCIL_ORDER], *ym[STENCIL_ORDER];
+                        for (usz o = 1; o <= STENCIL_ORDER; ++o)
+                        {
+                            xp[o - 1] = plane[STENCIL_ORDER + o] + rows[r];
+                            xm[o - 1] = plane[STENCIL_ORDER - o] + rows[r];
+                            yp[o - 1] = centre + rows[r + o];
+                            ym[o - 1] = centre + rows[r - o];
+                        }
+
+                        #pragma omp simd aligned(C_span_value:32) reduction(+: sum_sq, nonfinite) reduction(max: max_abs)
+                        for (usz k = kk; k < max_k; ++k)
                         {
-                            f64 sum = A_span_value[i][j][k] * B_span_value[i][j][k];
+                            f64 sum = row[k];
 
                             #pragma GCC unroll 8
                             for (usz o = 1; o <= STENCIL_ORDER; ++o)
                             {
-                                sum += (A_span_value[i + o][j][k] * B_span_value[i + o][j][k]
-                                      + A_span_value[i - o][j][k] * B_span_value[i - o][j][k]
-                                      + A_span_value[i][j + o][k] * B_span_value[i][j + o][k]
-                                      + A_span_value[i][j - o][k] * B_span_value[i][j - o][k]
-                                      + A_span_value[i][j][k + o] * B_span_value[i][j][k + o]
-                                      + A_span_value[i][j][k - o] * B_span_value[i][j][k - o] ) * pow17[o - 1];
+                                sum += (xp[o - 1][k]
+                                      + xm[o - 1][k]
+                                      + yp[o - 1][k]
+                                      + ym[o - 1][k]
+                                      + row[k + o]
+                                      + row[k - o] ) * pow17[o - 1];
                             }
 
                             C_span_value[i][j][k] = sum;
+                            sum_sq += sum * sum;
+                            max_abs = fmax(max_abs, fabs(sum));
+                            nonfinite += non_finite(sum);
+                        }
+                    }
+                }
+                diag_merge(&diag, &(solve_diag_t){ .sum_sq = sum_sq, .max_abs = max_abs, .nonfinite = nonfinite });
+                trace_end("kernel", "tile", "tile", tile_index(STENCIL_ORDER, jj, kk, 1, tj, tk, dim_y, dim_z), begin);
+            }
+        }
+        free(rows);
+        free(ring);
+
+        #pragma omp for collapse(2) schedule(static)
+        for (usz jj = STENCIL_ORDER; jj < dim_y - STENCIL_ORDER; jj += tj)
+        {
+            for (usz kk = STENCIL_ORDER; kk < dim_z - STENCIL_ORDER; kk += tk)
+            {
+                usz max_j = min(jj + tj, dim_y - STENCIL_ORDER);
+                usz max_k = min(kk + tk, dim_z - STENCIL_ORDER);
+
+                u64 const begin = trace_begin();
+                for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
+                    for (usz j = jj; j < max_j; ++j)
+                        memcpy(&A_span_value[i][j][kk], &C_span_value[i][j][kk], sizeof(f64) * (max_k - kk));
+                trace_end("copy", "copy", "tile", tile_index(STENCIL_ORDER, jj, kk, 1, tj, tk, dim_y, dim_z), begin);
+            }
+        }
+    }
+    return diag;
+}
+
+solve_diag_t solve_jacobi_streaming(mesh_t *A, mesh_t const *B, mesh_t *C)
+{
+    assert(A->dim_x == B->dim_x && B->dim_x == C->dim_x);
+    assert(A->dim_y == B->dim_y && B->dim_y == C->dim_y);
+    assert(A->dim_z == B->dim_z && B->dim_z == C->dim_z);
+
+    return window_kernel(A, B, streaming_plane, C);
+}
+
+solve_workspace_t solve_workspace_new(solver_kind_t kind, mesh_t const *A)
+{
+    solve_workspace_t self = { 0 };
+    if (SOLVER_KIND_SPLIT == kind)
+    {
+        self.len = A->dim_x * A->dim_y * A->dim_z;
+        // aligned_alloc wants a multiple of the alignment
+        usz const bytes = (sizeof(f64) * self.len + 31) & ~(usz)31;
+        self.product = aligned_alloc(32, bytes);
+        if (NULL == self.product)
+            error("failed to allocate %zu bytes for the product workspace", bytes);
+    }
+    return self;
+}
+
+void solve_workspace_drop(solve_workspace_t *self)
+{
+    free(self->product);
+    *self = (solve_workspace_t){ 0 };
+}
+
+solve_diag_t solve_jacobi_split(mesh_t *A, mesh_t const *B, mesh_t *C, solve_workspace_t const *workspace)
+{
+    assert(A->dim_x == B->dim_x && B->dim_x == C->dim_x);
+    assert(A->dim_y == B->dim_y && B->dim_y == C->dim_y);
+    assert(A->dim_z == B->dim_z && B->dim_z == C->dim_z);
+
+    usz const dim_x = A->dim_x;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64(*restrict B_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])B->value;
+    f64(*restrict C_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])C->value;
+    assert(NULL != workspace->product && workspace->len >= dim_x * dim_y * dim_z);
+    f64(*restrict P_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])workspace->product;
+
+    f64 pow17[STENCIL_ORDER];
+    jacobi_weights(pow17);
+
+    // Y tiles of the X pass: the `2 * STENCIL_ORDER + 1` planes of a tile stay cached while it
+    // marches along X, with at least one tile per thread
+    usz const core_y = dim_y - 2 * STENCIL_ORDER;
+    usz const nb_threads = (usz)omp_get_max_threads();
+    usz tj = streaming_cache_budget() / ((2 * STENCIL_ORDER + 1) * dim_z * sizeof(f64));
+    tj = min(tj, (core_y + nb_threads - 1) / nb_threads);
+    tj = tj > 0 ? tj : 1;
+    solve_diag_t diag = { 0 };
+
+    #pragma omp parallel
+    {
+        // Every product is read by up to 7 stencils: compute each one once. Passes end with an
+        // explicit barrier so that traces tell the pass apart from the wait for other threads.
+        u64 const begin_product = trace_begin();
+        #pragma omp for schedule(static) nowait
+        for (usz i = 0; i < dim_x; ++i)
+            for (usz j = 0; j < dim_y; ++j)
+                #pragma omp simd aligned(A_span_value, B_span_value, P_span_value:32)
+                for (usz k = 0; k < dim_z; ++k)
+                    P_span_value[i][j][k] = A_span_value[i][j][k] * B_span_value[i][j][k];
+        trace_end("kernel", "product", NULL, 0, begin_product);
+        #pragma omp barrier
+
+        // Z pass: contiguous neighbours, starts C from the centre point
+        u64 const begin_z = trace_begin();
+        #pragma omp for collapse(2) schedule(static) nowait
+        for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
+        {
+            for (usz j = STENCIL_ORDER; j < dim_y - STENCIL_ORDER; ++j)
+            {
+                #pragma omp simd aligned(C_span_value, P_span_value:32)
+                for (usz k = STENCIL_ORDER; k < dim_z - STENCIL_ORDER; ++k)
+                {
+                    f64 sum = P_span_value[i][j][k];
+                    #pragma GCC unroll 8
+                    for (usz o = 1; o <= STENCIL_ORDER; ++o)
+                        sum += (P_span_value[i][j][k + o] + P_span_value[i][j][k - o]) * pow17[o - 1];
+                    C_span_value[i][j][k] = sum;
+                }
+            }
+        }
+        trace_end("kernel", "z pass", NULL, 0, begin_z);
+        #pragma omp barrier
+
+        // X pass: streamed plane by plane along X for each Y tile
+        u64 const begin_x = trace_begin();
+        #pragma omp for schedule(static) nowait
+        for (usz jj = STENCIL_ORDER; jj < dim_y - STENCIL_ORDER; jj += tj)
+        {
+            usz max_j = min(jj + tj, dim_y - STENCIL_ORDER);
+            for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
+            {
+                for (usz j = jj; j < max_j; ++j)
+                {
+                    #pragma omp simd aligned(C_span_value, P_span_value:32)
+                    for (usz k = STENCIL_ORDER; k < dim_z - STENCIL_ORDER; ++k)
+                    {
+                        f64 sum = 0.0;
+                        #pragma GCC unroll 8
+                        for (usz o = 1; o <= STENCIL_ORDER; ++o)
+                            sum += (P_span_value[i + o][j][k] + P_span_value[i - o][j][k]) * pow17[o - 1];
+                        C_span_value[i][j][k] += sum;
+                    }
+                }
+            }
+        }
+        trace_end("kernel", "x pass", NULL, 0, begin_x);
+        #pragma omp barrier
+
+        // Y pass: within a plane, the `2 * STENCIL_ORDER + 1` rows around j stay cached. It
+        // completes C, so it also measures the new field.
+        u64 const begin_y = trace_begin();
+        f64 sum_sq = 0.0;
+        f64 max_abs = 0.0;
+        u64 nonfinite = 0;
+        #pragma omp for schedule(static) nowait
+        for (usz i = STENCIL_ORDER; i < dim_x - STENCIL_ORDER; ++i)
+        {
+            for (usz j = STENCIL_ORDER; j < dim_y - STENCIL_ORDER; ++j)
+            {
+                #pragma omp simd aligned(C_span_value, P_span_value:32) reduction(+: sum_sq, nonfinite) reduction(max: max_abs)
+                for (usz k = STENCIL_ORDER; k < dim_z - STENCIL_ORDER; ++k)
+                {
+                    f64 sum = 0.0;
+                    #pragma GCC unroll 8
+                    for (usz o = 1; o <= STENCIL_ORDER; ++o)
+                        sum += (P_span_value[i][j + o][k] + P_span_value[i][j - o][k]) * pow17[o - 1];
+                    f64 const value = C_span_value[i][j][k] + sum;
+                    C_span_value[i][j][k] = value;
+                    sum_sq += value * value;
+                    max_abs = fmax(max_abs, fabs(value));
+                    nonfinite += non_finite(value);
+                }
+            }
+        }
+        trace_end("kernel", "y pass", NULL, 0, begin_y);
+        #pragma omp critical
+        diag_merge(&diag, &(solve_diag_t){ .sum_sq = sum_sq, .max_abs = max_abs, .nonfinite = nonfinite });
+    }
+    mesh_copy_core(A, C);
+    return diag;
+}
+
+/// Returns `sin(x)` to within a few ulps for `|x|` up to about 1e6 in a form that vectorizes:
+/// Cody-Waite reduction by pi/2 (fused so that `-ffast-math` cannot reassociate it), then the
+/// Cephes minimax polynomials of sin and cos on [-pi/4, pi/4], selected by the quadrant.
+static inline f64 fast_sin(f64 x)
+{
+    f64 const PIO2_HI = 1.57079632679489655800e+00;
+    f64 const PIO2_LO = 6.12323399573676603587e-17;
+
+    f64 const q = floor(x * M_2_PI + 0.5);
+    f64 r = fma(-q, PIO2_HI, x);
+    r = fma(-q, PIO2_LO, r);
+    f64 const z = r * r;
+
+    f64 const s = r + r * z * (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z
+                                  + 2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z
+                                  + 8.33333333332211858878e-3) * z - 1.66666666666666307295e-1);
+    f64 const c = 1.0 - 0.5 * z + z * z * (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z
+                                             - 2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z
+                                             - 1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+
+    // Quadrant q mod 4: sin(r), cos(r), -sin(r), -cos(r)
+    f64 const quadrant = q - 4.0 * floor(q * 0.25);
+    f64 const half = floor(quadrant * 0.5);
+    f64 const value = (quadrant - 2.0 * half) > 0.5 ? c : s;
+    return half > 0.5 ? -value : value;
+}
+
+/// Products of a plane with B evaluated from its axis tables (`coef` is a `coef_tables_t`).
+static inline void matrix_free_plane(
+    f64 *restrict plane, mesh_t const *A, void const *tables, usz i, usz j0, usz j1, usz k0, usz k1)
+{
+    coef_tables_t const *coef = tables;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+    f64(*restrict A_span_value)[dim_y][dim_z] = (f64(*)[dim_y][dim_z])A->value;
+    f64 const *restrict coef_z = coef->z;
+    f64 const cx = coef->x[i];
+
+    for (usz j = j0 - STENCIL_ORDER; j < j1 + STENCIL_ORDER; ++j)
+    {
+        bool const tile_row = j >= j0 && j < j1;
+        usz const lo = tile_row ? k0 - STENCIL_ORDER : k0;
+        usz const hi = tile_row ? k1 + STENCIL_ORDER : k1;
+        f64 const cy = coef->y[j];
+        f64 *restrict row = &plane[window_row(j, j0, j1, k1 - k0) - k0];
+
+        // Same association as the initialization of B: (k * cos_i) * cos_j
+        #pragma omp simd
+        for (usz k = lo; k < hi; ++k)
+            row[k] = A_span_value[i][j][k] * fast_sin(coef_z[k] * cx * cy + 0.613);
+    }
+}
+
+solve_diag_t solve_jacobi_matrix_free(mesh_t *A, coef_tables_t const *coef, mesh_t *C)
+{
+    assert(A->dim_x == coef->dim_x && A->dim_x == C->dim_x);
+    assert(A->dim_y == coef->dim_y && A->dim_y == C->dim_y);
+    assert(A->dim_z == coef->dim_z && A->dim_z == C->dim_z);
+
+    return window_kernel(A, coef, matrix_free_plane, C);
+}
+
+/// Returns a pointer to the first value of a brick.
+static inline f64 const *brick_at(mesh_t const *mesh, usz bx, usz by, usz bz)
+{
+    return &mesh->value[((bx * mesh->bricks_y + by) * mesh->bricks_z + bz) * BRICK_SIZE];
+}
+
+/// Stores the products `a * b` of `BRICK_DIM` consecutive values.
+static inline void brick_row_product(f64 *restrict dst, f64 const *restrict a, f64 const *restrict b, usz n)
+{
+    #pragma omp simd
+    for (usz p = 0; p < n; ++p)
+        dst[p] = a[p] * b[p];
+}
+
+solve_diag_t solve_jacobi_bricked(mesh_t *A, mesh_t const *B, mesh_t *C)
+{
+    assert(A->dim_x == B->dim_x && B->dim_x == C->dim_x);
+    assert(A->dim_y == B->dim_y && B->dim_y == C->dim_y);
+    assert(A->dim_z == B->dim_z && B->dim_z == C->dim_z);
+    assert(MESH_LAYOUT_BRICKED == A->layout && A->layout == B->layout && B->layout == C->layout);
+
+    usz const dim_x = A->dim_x;
+    usz const dim_y = A->dim_y;
+    usz const dim_z = A->dim_z;
+
+    f64 pow17[STENCIL_ORDER];
+    for (usz o = 0; o < STENCIL_ORDER; ++o)
+        pow17[o] = 1.0 / pow(17.0, (f64)(o + 1));
+
+    // Ghost cells are exactly one brick wide: core bricks start at brick 1
+    usz const last_bx = (dim_x - STENCIL_ORDER + BRICK_DIM - 1) >> BRICK_SHIFT;
+    usz const last_by = (dim_y - STENCIL_ORDER + BRICK_DIM - 1) >> BRICK_SHIFT;
+    usz const last_bz = (dim_z - STENCIL_ORDER + BRICK_DIM - 1) >> BRICK_SHIFT;
+    solve_diag_t diag = { 0 };
+
+    #pragma omp parallel for collapse(3) schedule(static) reduction(diag: diag)
+    for (usz bx = 1; bx < last_bx; ++bx)
+    {
+        for (usz by = 1; by < last_by; ++by)
+        {
+            for (usz bz = 1; bz < last_bz; ++bz)
+            {
+                // The brick and its 6 face neighbours hold every point the stencil reads
+                f64 const *a = brick_at(A, bx, by, bz), *b = brick_at(B, bx, by, bz);
+                f64 const *a_xm = brick_at(A, bx - 1, by, bz), *b_xm = brick_at(B, bx - 1, by, bz);
+                f64 const *a_xp = brick_at(A, bx + 1, by, bz), *b_xp = brick_at(B, bx + 1, by, bz);
+                f64 const *a_ym = brick_at(A, bx, by - 1, bz), *b_ym = brick_at(B, bx, by - 1, bz);
+                f64 const *a_yp = brick_at(A, bx, by + 1, bz), *b_yp = brick_at(B, bx, by + 1, bz);
+                f64 const *a_zm = brick_at(A, bx, by, bz - 1), *b_zm = brick_at(B, bx, by, bz - 1);
+                f64 const *a_zp = brick_at(A, bx, by, bz + 1), *b_zp = brick_at(B, bx, by, bz + 1);
+
+                // Products A*B of the brick extended by its halo along each axis
+                usz const E = 3 * BRICK_DIM;
+                f64 px[E][BRICK_DIM][BRICK_DIM] __attribute__((aligned(32)));
+                f64 py[BRICK_DIM][E][BRICK_DIM] __attribute__((aligned(32)));
+                f64 pz[BRICK_DIM][BRICK_DIM][E] __attribute__((aligned(32)));
+                brick_row_product(&px[0][0][0], a_xm, b_xm, BRICK_SIZE);
+                brick_row_product(&px[BRICK_DIM][0][0], a, b, BRICK_SIZE);
+                brick_row_product(&px[2 * BRICK_DIM][0][0], a_xp, b_xp, BRICK_SIZE);
+                for (usz i = 0; i < BRICK_DIM; ++i)
+                {
+                    usz const p = i * BRICK_DIM * BRICK_DIM;
+                    brick_row_product(&py[i][0][0], &a_ym[p], &b_ym[p], BRICK_DIM * BRICK_DIM);
+                    brick_row_product(&py[i][BRICK_DIM][0], &a[p], &b[p], BRICK_DIM * BRICK_DIM);
+                    brick_row_product(&py[i][2 * BRICK_DIM][0], &a_yp[p], &b_yp[p], BRICK_DIM * BRICK_DIM);
+                    for (usz j = 0; j < BRICK_DIM; ++j)
+                    {
+                        usz const r = p + j * BRICK_DIM;
+                        brick_row_product(&pz[i][j][0], &a_zm[r], &b_zm[r], BRICK_DIM);
+                        brick_row_product(&pz[i][j][BRICK_DIM], &a[r], &b[r], BRICK_DIM);
+                        brick_row_product(&pz[i][j][2 * BRICK_DIM], &a_zp[r], &b_zp[r], BRICK_DIM);
+                    }
+                }
+
+                f64 sum[BRICK_DIM][BRICK_DIM][BRICK_DIM] __attribute__((aligned(32)));
+                for (usz i = 0; i < BRICK_DIM; ++i)
+                {
+                    for (usz j = 0; j < BRICK_DIM; ++j)
+                    {
+                        #pragma omp simd
+                        for (usz k = 0; k < BRICK_DIM; ++k)
+                        {
+                            f64 acc = px[BRICK_DIM + i][j][k];
+
+                            #pragma GCC unroll 8
+                            for (usz o = 1; o <= STENCIL_ORDER; ++o)
+                            {
+                                acc += (px[BRICK_DIM + i + o][j][k]
+                                      + px[BRICK_DIM + i - o][j][k]
+                                      + py[i][BRICK_DIM + j + o][k]
+                                      + py[i][BRICK_DIM + j - o][k]
+                                      + pz[i][j][BRICK_DIM + k + o]
+                                      + pz[i][j][BRICK_DIM + k - o] ) * pow17[o - 1];
+                            }
+
+                            sum[i][j][k] = acc;
                         }
                     }
                 }
+
+                // Partial bricks at the upper edges only write their core points
+                usz const ni = min((bx + 1) * BRICK_DIM, dim_x - STENCIL_ORDER) - bx * BRICK_DIM;
+                usz const nj = min((by + 1) * BRICK_DIM, dim_y - STENCIL_ORDER) - by * BRICK_DIM;
+                usz const nk = min((bz + 1) * BRICK_DIM, dim_z - STENCIL_ORDER) - bz * BRICK_DIM;
+                f64 *c = (f64 *)brick_at(C, bx, by, bz);
+
+                // Measured on the brick while it is still in registers and L1
+                f64 sum_sq = 0.0;
+                f64 max_abs = 0.0;
+                u64 nonfinite = 0;
+                for (usz i = 0; i < ni; ++i)
+                {
+                    for (usz j = 0; j < nj; ++j)
+                    {
+                        #pragma omp simd reduction(+: sum_sq, nonfinite) reduction(max: max_abs)
+                        for (usz k = 0; k < nk; ++k)
+                        {
+                            f64 const value = sum[i][j][k];
+                            sum_sq += value * value;
+                            max_abs = fmax(max_abs, fabs(value));
+                            nonfinite += non_finite(value);
+                        }
+                    }
+                }
+                diag_merge(&diag, &(solve_diag_t){ .sum_sq = sum_sq, .max_abs = max_abs, .nonfinite = nonfinite });
+
+                if (BRICK_DIM == ni && BRICK_DIM == nj && BRICK_DIM == nk)
+                {
+                    memcpy(c, sum, sizeof(sum));
+                }
+                else
+                {
+                    for (usz i = 0; i < ni; ++i)
+                        for (usz j = 0; j < nj; ++j)
+                            memcpy(&c[(i * BRICK_DIM + j) * BRICK_DIM], sum[i][j], sizeof(f64) * nk);
+                }
             }
         }
     }
     mesh_copy_core(A, C);
-}
\ No newline at end of file
+    return diag;
+}
+
+solve_diag_t solve_jacobi_with(
+    solver_kind_t kind, mesh_t *A, mesh_t const *B, mesh_t *C, solve_workspace_t const *workspace)
+{
+    // Only the bricked kernel understands bricked meshes
+    if (MESH_LAYOUT_BRICKED == A->layout)
+    {
+        return solve_jacobi_bricked(A, B, C);
+    }
+
+    switch (kind)
+    {
+    case SOLVER_KIND_BLOCKED:
+        return solve_jacobi(A, B, C);
+    case SOLVER_KIND_STREAMING:
+        return solve_jacobi_streaming(A, B, C);
+    case SOLVER_KIND_SPLIT:
+        return solve_jacobi_split(A, B, C, workspace);
+    case SOLVER_KIND_MATRIX_FREE:
+        error("the `%s` kernel has no B, use solve_jacobi_matrix_free", solver_kind_as_str(kind));
+    default:
+        __builtin_unreachable();
+    }
+}
+
+/// Returns the bytes of the meshes a kernel reads as inputs (A, and B unless it evaluates it).
+static usz input_bytes(solver_kind_t kind, mesh_t const *A)
+{
+    usz const inputs = (SOLVER_KIND_MATRIX_FREE == kind) ? 1 : 2;
+    return sizeof(f64) * inputs * A->dim_x * A->dim_y * A->dim_z;
+}
+
+usz solve_compulsory_bytes(solver_kind_t kind, mesh_t const *A)
+{
+    usz const core = (A->dim_x - 2 * STENCIL_ORDER) * (A->dim_y - 2 * STENCIL_ORDER)
+                   * (A->dim_z - 2 * STENCIL_ORDER);
+    // Read A and B, write C, then read C and write A for the copy
+    return input_bytes(kind, A) + sizeof(f64) * 3 * core;
+}
+
+f64 solve_modelled_bytes(solver_kind_t kind, mesh_t const *A)
+{
+    f64 const inputs = (f64)input_bytes(kind, A);
+    return (f64)solve_compulsory_bytes(kind, A) + (solve_read_amplification(kind, A) - 1.0) * inputs;
+}
+
+f64 solve_read_amplification(solver_kind_t kind, mesh_t const *A)
+{
+    usz const core_x = A->dim_x - 2 * STENCIL_ORDER;
+    usz const core_y = A->dim_y - 2 * STENCIL_ORDER;
+    usz const core_z = A->dim_z - 2 * STENCIL_ORDER;
+    usz const halo = 2 * STENCIL_ORDER;
+
+    if (MESH_LAYOUT_BRICKED == A->layout)
+    {
+        // One brick plus its 6 halo slabs
+        return (f64)(BRICK_SIZE + 6 * STENCIL_ORDER * BRICK_DIM * BRICK_DIM) / (f64)BRICK_SIZE;
+    }
+
+    switch (kind)
+    {
+    case SOLVER_KIND_BLOCKED:
+    {
+        // A BI x BJ x BK tile reads its own points plus the 3 pairs of halo slabs (star stencil)
+        f64 const ti = (f64)min(BI, core_x);
+        f64 const tj = (f64)min(BJ, core_y);
+        f64 const tk = (f64)min(BK, core_z);
+        return (ti * tj * tk + halo * (tj * tk + ti * tk + ti * tj)) / (ti * tj * tk);
+    }
+    case SOLVER_KIND_STREAMING:
+    case SOLVER_KIND_MATRIX_FREE:
+    {
+        // Planes are reused along X, only the Y and Z halos of the tiles are read more than once
+        usz tj, tk;
+        streaming_tile_size(core_y, core_z, &tj, &tk);
+        f64 const nj = (f64)((core_y + tj - 1) / tj);
+        f64 const nk = (f64)((core_z + tk - 1) / tk);
+        return 1.0 + halo * (nj * (f64)core_z + nk * (f64)core_y) / ((f64)core_y * (f64)core_z);
+    }
+    case SOLVER_KIND_SPLIT:
+        // A and B read once, then the products read by each of the 3 passes and C read back by
+        // the X and Y passes: 7 streams where the fused kernels ideally need 2
+        return 3.5;
+    default:
+        __builtin_unreachable();
+    }
+}
@@ -0,0 +1,391 @@
+#include "stencil/subdomains.h"
+
+#include "logging.h"
+#include "stencil/trace.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_LINKS SUBDOMAIN_NB_LINKS
+
+/// Trace event names of the faces sent to another rank on each link.
+static char const* const LINK_SEND_EVENT[NB_LINKS] = {
+    "send right", "send left", "send top", "send bottom", "send back", "send front",
+};
+
+/// Link `l` sends the high (even `l`) or low (odd `l`) core slab on axis `l / 2` and receives
+/// the opposite ghost slab, in the same directions as `comm_handler_ghost_exchange`.
+static u32 link_axis(usz l) {
+    return (u32)(l / 2);
+}
+
+static bool link_high(usz l) {
+    return 0 == l % 2;
+}
+
+/// Ghost-inclusive box of the face sent (`recv == false`) or received on link `l`.
+static void link_box(usz l, mesh_t const* mesh, bool recv, usz lo[3], usz hi[3]) {
+    usz const dim[3] = { mesh->dim_x, mesh->dim_y, mesh->dim_z };
+    for (u32 a = 0; a < 3; ++a) {
+        lo[a] = STENCIL_ORDER;
+        hi[a] = dim[a] - STENCIL_ORDER;
+    }
+    u32 const a = link_axis(l);
+    if (recv) {
+        lo[a] = link_high(l) ? 0 : dim[a] - STENCIL_ORDER;
+    } else {
+        lo[a] = link_high(l) ? dim[a] - 2 * STENCIL_ORDER : STENCIL_ORDER;
+    }
+    hi[a] = lo[a] + STENCIL_ORDER;
+}
+
+/// Message tag of the face received by slab `s` on link `l` during an iteration of parity `p`.
+static i32 face_tag(usz s, usz l, usz p) {
+    return (i32)(((s * NB_LINKS) + l) * 2 + p);
+}
+
+subdomains_t subdomains_new(comm_handler_t const* comm_handler, usz nb, mesh_t const* B) {
+    assert(MESH_LAYOUT_ROW_MAJOR == B->layout);
+    usz const core_x = comm_handler->loc_dim_x;
+    if (nb < 1 || core_x / nb < STENCIL_ORDER) {
+        error("cannot split %zu planes into %zu slabs of at least %lu planes", core_x, nb, STENCIL_ORDER);
+    }
+
+    usz const n = nb * NB_LINKS;
+    subdomains_t self = {
+        .nb = nb,
+        .x0 = malloc(sizeof(usz) * (nb + 1)),
+        .A = malloc(sizeof(mesh_t) * nb),
+        .B = malloc(sizeof(mesh_t) * nb),
+        .C = malloc(sizeof(mesh_t) * nb),
+        .target_local = malloc(sizeof(i32) * n),
+        .target_remote = malloc(sizeof(i32) * n),
+        .source_local = malloc(sizeof(i32) * n),
+        .source_remote = malloc(sizeof(i32) * n),
+        .remote_slab = malloc(sizeof(i32) * n),
+        .face_len = malloc(sizeof(usz) * n),
+    };
+
+    // Same split as the ranks: the last slab absorbs the remainder
+    for (usz s = 0; s < nb; ++s) {
+        self.x0[s] = s * (core_x / nb);
+    }
+    self.x0[nb] = core_x;
+
+    i32 const last = (i32)nb - 1;
+    i32 const remote_target[NB_LINKS] = {
+        comm_handler->id_right, comm_handler->id_left, comm_handler->id_top,
+        comm_handler->id_bottom, comm_handler->id_back, comm_handler->id_front,
+    };
+    i32 const remote_source[NB_LINKS] = {
+        comm_handler->id_left, comm_handler->id_right, comm_handler->id_bottom,
+        comm_handler->id_top, comm_handler->id_front, comm_handler->id_back,
+    };
+    for (usz s = 0; s < nb; ++s) {
+        usz const lx = self.x0[s + 1] - self.x0[s];
+        self.A[s] = mesh_new(lx, comm_handler->loc_dim_y, comm_handler->loc_dim_z, MESH_KIND_INPUT);
+        self.B[s] = mesh_new(lx, comm_handler->loc_dim_y, comm_handler->loc_dim_z, MESH_KIND_CONSTANT);
+        self.C[s] = mesh_new(lx, comm_handler->loc_dim_y, comm_handler->loc_dim_z, MESH_KIND_OUTPUT);
+
+        for (usz l = 0; l < NB_LINKS; ++l) {
+            usz const f = s * NB_LINKS + l;
+            self.target_local[f] = -1;
+            self.source_local[f] = -1;
+            self.target_remote[f] = remote_target[l];
+            self.source_remote[f] = remote_source[l];
+            self.remote_slab[f] = (i32)s;
+
+            // Along X, only the outer slabs talk to other ranks
+            if (0 == link_axis(l)) {
+                i32 const up = (i32)s + 1, down = (i32)s - 1;
+                i32 const to = link_high(l) ? up : down, from = link_high(l) ? down : up;
+                if (to >= 0 && to <= last) {
+                    self.target_local[f] = to;
+                    self.target_remote[f] = -1;
+                } else {
+                    self.remote_slab[f] = link_high(l) ? 0 : last;
+                }
+                if (from >= 0 && from <= last) {
+                    self.source_local[f] = from;
+                    self.source_remote[f] = -1;
+                }
+            }
+
+            usz lo[3], hi[3];
+            link_box(l, &self.A[s], false, lo, hi);
+            self.face_len[f] = (hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]);
+        }
+    }
+
+    for (usz p = 0; p < 2; ++p) {
+        self.halo[p] = malloc(sizeof(f64*) * n);
+        self.send[p] = malloc(sizeof(f64*) * n);
+        self.recv_req[p] = malloc(sizeof(MPI_Request) * n);
+        self.send_req[p] = malloc(sizeof(MPI_Request) * n);
+        for (usz f = 0; f < n; ++f) {
+            bool const has_source = self.source_local[f] >= 0 || self.source_remote[f] >= 0;
+            self.halo[p][f] = has_source ? malloc(sizeof(f64) * self.face_len[f]) : NULL;
+            self.send[p][f] = self.target_remote[f] >= 0 ? malloc(sizeof(f64) * self.face_len[f]) : NULL;
+            self.recv_req[p][f] = MPI_REQUEST_NULL;
+            self.send_req[p][f] = MPI_REQUEST_NULL;
+        }
+    }
+
+    // B is constant, it only needs to be split once
+    for (usz s = 0; s < nb; ++s) {
+        usz const plane = B->dim_y * B->dim_z;
+        memcpy(self.B[s].value, &B->value[self.x0[s] * plane], sizeof(f64) * self.B[s].dim_x * plane);
+    }
+
+    return self;
+}
+
+void subdomains_drop(subdomains_t* self) {
+    usz const n = self->nb * NB_LINKS;
+    for (usz p = 0; p < 2; ++p) {
+        MPI_Waitall((i32)n, self->send_req[p], MPI_STATUSES_IGNORE);
+        for (usz f = 0; f < n; ++f) {
+            free(self->halo[p][f]);
+            free(self->send[p][f]);
+        }
+        free(self->halo[p]);
+        free(self->send[p]);
+        free(self->recv_req[p]);
+        free(self->send_req[p]);
+    }
+    for (usz s = 0; s < self->nb; ++s) {
+        mesh_drop(&self->A[s]);
+        mesh_drop(&self->B[s]);
+        mesh_drop(&self->C[s]);
+    }
+    free(self->x0);
+    free(self->A);
+    free(self->B);
+    free(self->C);
+    free(self->target_local);
+    free(self->target_remote);
+    free(self->source_local);
+    free(self->source_remote);
+    free(self->remote_slab);
+    free(self->face_len);
+    *self = (subdomains_t){ 0 };
+}
+
+void subdomains_scatter(subdomains_t* self, mesh_t const* A, mesh_t const* C) {
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout && MESH_LAYOUT_ROW_MAJOR == C->layout);
+    usz const plane = A->dim_y * A->dim_z;
+    for (usz s = 0; s < self->nb; ++s) {
+        // Ghost planes of a slab are the core planes of its neighbours, or those of the rank
+        usz const len = self->A[s].dim_x * plane;
+        memcpy(self->A[s].value, &A->value[self->x0[s] * plane], sizeof(f64) * len);
+        memcpy(self->C[s].value, &C->value[self->x0[s] * plane], sizeof(f64) * len);
+    }
+}
+
+void subdomains_gather(subdomains_t const* self, mesh_t* A) {
+    assert(MESH_LAYOUT_ROW_MAJOR == A->layout);
+    usz const plane = A->dim_y * A->dim_z;
+    for (usz s = 0; s < self->nb; ++s) {
+        usz const lx = self->x0[s + 1] - self->x0[s];
+        memcpy(
+            &A->value[(STENCIL_ORDER + self->x0[s]) * plane],
+            &self->A[s].value[STENCIL_ORDER * plane],
+            sizeof(f64) * lx * plane
+        );
+    }
+}
+
+/// Copies the incoming faces of parity `p` of slab `s` into its ghost cells.
+static void unpack_halos(subdomains_t* self, usz s, usz p) {
+    mesh_t* A = &self->A[s];
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        f64 const* face = self->halo[p][s * NB_LINKS + l];
+        if (NULL != face) {
+            usz lo[3], hi[3];
+            link_box(l, A, true, lo, hi);
+            mesh_unpack(A, face, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+        }
+    }
+}
+
+/// Advances slab `s` by one iteration, then hands its new faces to its neighbours for the
+/// next iteration (parity `q`): copied straight into the incoming buffer of a slab of this
+/// rank, or sent to another rank.
+static void step_slab(
+    subdomains_t* self,
+    usz s,
+    usz p,
+    usz q,
+    bool unpack,
+    solver_kind_t kind,
+    solve_workspace_t const* workspace,
+    MPI_Comm comm
+) {
+    mesh_t* A = &self->A[s];
+    if (unpack) {
+        unpack_halos(self, s, p);
+    }
+
+    u64 begin = trace_begin();
+    solve_jacobi_with(kind, A, &self->B[s], &self->C[s], workspace);
+    trace_end("kernel", "slab", "slab", (i64)s, begin);
+
+    for (usz l = 0; l < NB_LINKS; ++l) {
+        usz const f = s * NB_LINKS + l;
+        usz lo[3], hi[3];
+        link_box(l, A, false, lo, hi);
+        if (self->target_local[f] >= 0) {
+            begin = trace_begin();
+            usz const t = (usz)self->target_local[f];
+            mesh_pack(A, self->halo[q][t * NB_LINKS + l], lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            trace_end("copy", "halo copy", "slab", (i64)t, begin);
+        } else if (self->target_remote[f] >= 0) {
+            begin = trace_begin();
+            // The buffer was last sent two iterations ago
+            MPI_Wait(&self->send_req[q][f], MPI_STATUS_IGNORE);
+            mesh_pack(A, self->send[q][f], lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+            MPI_Isend(
+                self->send[q][f],
+                (i32)self->face_len[f],
+                MPI_DOUBLE,
+                self->target_remote[f],
+                face_tag((usz)self->remote_slab[f], l, q),
+                comm,
+                &self->send_req[q][f]
+            );
+            trace_end("exchange", LINK_SEND_EVENT[l], "peer", self->target_remote[f], begin);
+        }
+    }
+}
+
+/// Counts the faces reported by `MPI_Testsome`/`MPI_Waitsome` as arrived.
+static void faces_arrived(i32 outcount, i32 const* indices, usz* pending, usz* outstanding) {
+    if (MPI_UNDEFINED == outcount) {
+        return;
+    }
+    for (i32 i = 0; i < outcount; ++i) {
+        pending[(usz)indices[i] / NB_LINKS] -= 1;
+        *outstanding -= 1;
+    }
+}
+
+void subdomains_run(
+    subdomains_t* self,
+    comm_handler_t const* comm_handler,
+    solver_kind_t kind,
+    solve_workspace_t const* workspace,
+    usz niter,
+    usz nb_probes,
+    usz const (*probes)[3],
+    f64* values
+) {
+    if (0 == niter) {
+        return;
+    }
+
+    usz const nb = self->nb;
+    usz const n = nb * NB_LINKS;
+    MPI_Comm const comm = comm_handler->comm;
+    bool* done = malloc(sizeof(bool) * nb);
+    usz* pending = malloc(sizeof(usz) * nb);
+    i32* indices = malloc(sizeof(i32) * n);
+
+    // Slab holding each probe, and the probe coordinates inside it
+    usz* probe_slab = malloc(sizeof(usz) * (nb_probes > 0 ? nb_probes : 1));
+    usz* probe_x = malloc(sizeof(usz) * (nb_probes > 0 ? nb_probes : 1));
+    for (usz p = 0; p < nb_probes; ++p) {
+        usz const x = probes[p][0] - STENCIL_ORDER;
+        usz s = 0;
+        while (x >= self->x0[s + 1]) {
+            s += 1;
+        }
+        probe_slab[p] = s;
+        probe_x[p] = x - self->x0[s] + STENCIL_ORDER;
+    }
+
+    // Slabs sending to other ranks are advanced first so their faces leave early
+    usz* nb_remote = calloc(nb, sizeof(usz));
+    for (usz f = 0; f < n; ++f) {
+        nb_remote[f / NB_LINKS] += self->target_remote[f] >= 0 ? 1 : 0;
+    }
+
+    for (usz it = 0; it < niter; ++it) {
+        usz const p = it % 2;
+        usz const q = 1 - p;
+
+        // Faces computed during this iteration are read by the next one
+        for (usz f = 0; f < n; ++f) {
+            if (self->source_remote[f] >= 0) {
+                MPI_Irecv(
+                    self->halo[q][f],
+                    (i32)self->face_len[f],
+                    MPI_DOUBLE,
+                    self->source_remote[f],
+                    face_tag(f / NB_LINKS, f % NB_LINKS, q),
+                    comm,
+                    &self->recv_req[q][f]
+                );
+            }
+        }
+
+        // The first iteration reads the ghost cells left by the scatter or the previous run
+        usz outstanding = 0;
+        for (usz s = 0; s < nb; ++s) {
+            done[s] = false;
+            pending[s] = 0;
+        }
+        for (usz f = 0; f < n; ++f) {
+            if (MPI_REQUEST_NULL != self->recv_req[p][f]) {
+                pending[f / NB_LINKS] += 1;
+                outstanding += 1;
+            }
+        }
+
+        for (usz left = nb; left > 0;) {
+            i32 outcount;
+            if (outstanding > 0) {
+                MPI_Testsome((i32)n, self->recv_req[p], &outcount, indices, MPI_STATUSES_IGNORE);
+                faces_arrived(outcount, indices, pending, &outstanding);
+            }
+
+            usz next = nb;
+            for (usz s = 0; s < nb; ++s) {
+                if (!done[s] && 0 == pending[s] && (nb == next || nb_remote[s] > nb_remote[next])) {
+                    next = s;
+                }
+            }
+            if (nb == next) {
+                // Nothing left to do until a face arrives
+                u64 const begin = trace_begin();
+                MPI_Waitsome((i32)n, self->recv_req[p], &outcount, indices, MPI_STATUSES_IGNORE);
+                trace_end("barrier", "wait faces", NULL, 0, begin);
+                faces_arrived(outcount, indices, pending, &outstanding);
+                continue;
+            }
+
+            step_slab(self, next, p, q, it > 0, kind, workspace, comm);
+            done[next] = true;
+            left -= 1;
+        }
+
+        for (usz pr = 0; pr < nb_probes; ++pr) {
+            values[it * nb_probes + pr] =
+                idx_const(&self->A[probe_slab[pr]], probe_x[pr], probes[pr][1], probes[pr][2]);
+        }
+    }
+
+    // Faces of the last iteration are the ghost cells of the next run
+    usz const p = niter % 2;
+    MPI_Waitall((i32)n, self->recv_req[p], MPI_STATUSES_IGNORE);
+    for (usz s = 0; s < nb; ++s) {
+        unpack_halos(self, s, p);
+    }
+
+    free(nb_remote);
+    free(probe_slab);
+    free(probe_x);
+    free(indices);
+    free(pending);
+    free(done);
+}
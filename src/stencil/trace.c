@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+
+#include "stencil/trace.h"
+
+#include "logging.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Round trips with rank 0 used to estimate the clock offset of a rank.
+#define NB_PINGS 16
+/// Message tag of the clock synchronization, away from the ghost exchange ones.
+#define TRACE_TAG 0x7ace
+
+trace_t TRACE = { 0 };
+
+void trace_init(usz capacity) {
+    trace_drop();
+    TRACE.capacity = capacity > 0 ? capacity : 1;
+    TRACE.nb_threads = (u32)omp_get_max_threads();
+    TRACE.rings = aligned_alloc(64, sizeof(trace_ring_t) * TRACE.nb_threads);
+    if (NULL == TRACE.rings) {
+        error("failed to allocate the trace rings of %u threads", TRACE.nb_threads);
+    }
+    for (u32 t = 0; t < TRACE.nb_threads; ++t) {
+        TRACE.rings[t] = (trace_ring_t){
+            .events = malloc(sizeof(trace_event_t) * TRACE.capacity),
+            .len = 0,
+        };
+        if (NULL == TRACE.rings[t].events) {
+            error("failed to allocate %zu bytes of trace events", sizeof(trace_event_t) * TRACE.capacity);
+        }
+    }
+    TRACE.enabled = true;
+}
+
+void trace_drop(void) {
+    for (u32 t = 0; t < TRACE.nb_threads; ++t) {
+        free(TRACE.rings[t].events);
+    }
+    free(TRACE.rings);
+    TRACE = (trace_t){ 0 };
+}
+
+/// Returns what to add to the local clock to read the clock of rank 0, taken from the fastest of
+/// `NB_PINGS` round trips with rank 0, whose reply is assumed to be sent halfway (collective).
+static i64 clock_offset(MPI_Comm comm) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm, &comm_size);
+
+    i64 offset = 0;
+    for (i32 r = 1; r < comm_size; ++r) {
+        if (0 == rank) {
+            for (usz p = 0; p < NB_PINGS; ++p) {
+                u64 t0;
+                MPI_Recv(&t0, 1, MPI_UINT64_T, r, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+                t0 = trace_now();
+                MPI_Send(&t0, 1, MPI_UINT64_T, r, TRACE_TAG, comm);
+            }
+        } else if (r == rank) {
+            u64 best = UINT64_MAX;
+            for (usz p = 0; p < NB_PINGS; ++p) {
+                u64 const t1 = trace_now();
+                u64 t0;
+                MPI_Send(&t1, 1, MPI_UINT64_T, 0, TRACE_TAG, comm);
+                MPI_Recv(&t0, 1, MPI_UINT64_T, 0, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+                u64 const t2 = trace_now();
+                if (t2 - t1 < best) {
+                    best = t2 - t1;
+                    offset = (i64)t0 - (i64)(t1 + (t2 - t1) / 2);
+                }
+            }
+        }
+    }
+    return offset;
+}
+
+/// Formats the events kept by this rank as JSON objects, each one followed by ",\n".
+/// Timestamps are in microseconds since `epoch` on the clock of rank 0.
+static char* format_events(i32 rank, i64 offset, u64 epoch, usz* len) {
+    char* text = NULL;
+    FILE* fp = open_memstream(&text, len);
+    if (NULL == fp) {
+        error("failed to open the trace buffer of rank %d", rank);
+    }
+
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n", rank, rank);
+    fprintf(fp, "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}},\n", rank, rank);
+    for (u32 t = 0; t < TRACE.nb_threads; ++t) {
+        trace_ring_t const* ring = &TRACE.rings[t];
+        fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}},\n",
+                rank, t, t);
+
+        usz const first = ring->len > TRACE.capacity ? ring->len - TRACE.capacity : 0;
+        for (usz e = first; e < ring->len; ++e) {
+            trace_event_t const* ev = &ring->events[e % TRACE.capacity];
+            f64 const ts = (f64)((i64)ev->begin_ns + offset - (i64)epoch) * 1.0e-3;
+            f64 const dur = (f64)(ev->end_ns - ev->begin_ns) * 1.0e-3;
+            fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3lf,\"dur\":%.3lf",
+                    ev->name, ev->cat, rank, t, ts, dur);
+            if (NULL != ev->arg_name) {
+                fprintf(fp, ",\"args\":{\"%s\":%ld}", ev->arg_name, ev->arg);
+            }
+            fputs("},\n", fp);
+        }
+    }
+
+    fclose(fp);
+    return text;
+}
+
+void trace_write(char const* path, MPI_Comm comm) {
+    i32 rank;
+    MPI_Comm_rank(comm, &rank);
+    i32 comm_size;
+    MPI_Comm_size(comm, &comm_size);
+
+    // Events stop being recorded while their clocks are aligned and gathered
+    bool const enabled = TRACE.enabled;
+    TRACE.enabled = false;
+
+    i64 const offset = clock_offset(comm);
+    u64 epoch = UINT64_MAX;
+    usz overwritten = 0;
+    for (u32 t = 0; t < TRACE.nb_threads; ++t) {
+        trace_ring_t const* ring = &TRACE.rings[t];
+        usz const first = ring->len > TRACE.capacity ? ring->len - TRACE.capacity : 0;
+        for (usz e = first; e < ring->len; ++e) {
+            u64 const begin = (u64)((i64)ring->events[e % TRACE.capacity].begin_ns + offset);
+            epoch = begin < epoch ? begin : epoch;
+        }
+        overwritten += first;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &epoch, 1, MPI_UINT64_T, MPI_MIN, comm);
+    if (overwritten > 0) {
+        warn("rank %d: %zu trace events overwritten, raise `trace_events` to keep them", rank, overwritten);
+    }
+
+    usz len;
+    char* text = format_events(rank, offset, epoch, &len);
+    if (len > INT32_MAX) {
+        error("rank %d: trace of %zu bytes is too large to be gathered", rank, len);
+    }
+    i32 const loc_len = (i32)len;
+
+    i32* counts = NULL;
+    i32* displs = NULL;
+    char* all = NULL;
+    usz total = 0;
+    if (0 == rank) {
+        counts = malloc(sizeof(i32) * (usz)comm_size);
+        displs = malloc(sizeof(i32) * (usz)comm_size);
+    }
+    MPI_Gather(&loc_len, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+    if (0 == rank) {
+        for (i32 r = 0; r < comm_size; ++r) {
+            if (total + (usz)counts[r] > INT32_MAX) {
+                error("trace of %zu bytes is too large to be gathered", total + (usz)counts[r]);
+            }
+            displs[r] = (i32)total;
+            total += (usz)counts[r];
+        }
+        all = malloc(total);
+    }
+    MPI_Gatherv(text, loc_len, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, comm);
+
+    if (0 == rank) {
+        FILE* ofp = fopen(path, "wb");
+        if (NULL == ofp) {
+            error("failed to open trace file `%s`", path);
+        }
+        // Rank 0 always sends its metadata, the trailing ",\n" of the last object is dropped
+        fputs("{\"traceEvents\":[\n", ofp);
+        fwrite(all, 1, total - 2, ofp);
+        fputs("\n],\"displayTimeUnit\":\"ms\"}\n", ofp);
+        fclose(ofp);
+    }
+
+    free(all);
+    free(counts);
+    free(displs);
+    free(text);
+    TRACE.enabled = enabled;
+}